@@ -0,0 +1,48 @@
+#!/bin/sh
+# Build boids with profile guided and link time optimization and report the gain on update_boids.
+#
+# 1. Release build (baseline) in $BASELINE_DIR.
+# 2. Instrumented build in $PGO_DIR, profile collected by running the boids_bench workload.
+# 3. Same build dir reconfigured to use the profile, with LTO enabled.
+# 4. boids_bench run on both builds.
+#
+# Usage: scripts/pgo_build.sh [boids_bench arguments used for training and measurement]
+# Extra CMake arguments can be passed with CMAKE_ARGS, e.g. CMAKE_ARGS=-DBOIDS_BUILD_VIEWER=OFF.
+
+set -e
+
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BASELINE_DIR=${BASELINE_DIR:-$SOURCE_DIR/build-release}
+PGO_DIR=${PGO_DIR:-$SOURCE_DIR/build-pgo}
+PROFILE_DIR=$PGO_DIR/pgo-profile
+JOBS=${JOBS:-$(nproc)}
+
+echo "== Baseline release build"
+cmake -S "$SOURCE_DIR" -B "$BASELINE_DIR" -DCMAKE_BUILD_TYPE=Release -DBOIDS_PGO=OFF $CMAKE_ARGS
+cmake --build "$BASELINE_DIR" -j"$JOBS"
+
+echo "== Instrumented build"
+# GCC names profiles after the object file paths, so the profile is generated and used in the same build dir
+cmake -S "$SOURCE_DIR" -B "$PGO_DIR" -DCMAKE_BUILD_TYPE=Release -DBOIDS_PGO=GENERATE -DBOIDS_CORE_LTO=OFF \
+  -DBOIDS_PGO_PROFILE_DIR="$PROFILE_DIR" $CMAKE_ARGS
+cmake --build "$PGO_DIR" -j"$JOBS"
+
+echo "== Collecting profile"
+rm -rf "$PROFILE_DIR"
+mkdir -p "$PROFILE_DIR"
+"$PGO_DIR/boids_bench" "$@" > /dev/null
+if ls "$PROFILE_DIR"/*.profraw > /dev/null 2>&1; then
+  # Clang writes raw profiles which have to be merged first
+  ${LLVM_PROFDATA:-llvm-profdata} merge -output="$PROFILE_DIR/boids.profdata" "$PROFILE_DIR"/*.profraw
+fi
+
+echo "== Profile guided + LTO build"
+cmake -S "$SOURCE_DIR" -B "$PGO_DIR" -DBOIDS_PGO=USE -DBOIDS_CORE_LTO=ON
+cmake --build "$PGO_DIR" -j"$JOBS"
+
+echo "== Benchmark"
+BASELINE_MS=$("$BASELINE_DIR/boids_bench" "$@" | awk '/^update_ms_per_tick:/ { print $2 }')
+PGO_MS=$("$PGO_DIR/boids_bench" "$@" | awk '/^update_ms_per_tick:/ { print $2 }')
+echo "release:       $BASELINE_MS ms/tick"
+echo "pgo + lto:     $PGO_MS ms/tick"
+awk -v baseline="$BASELINE_MS" -v pgo="$PGO_MS" 'BEGIN { printf "speedup:       %.2fx\n", baseline / pgo }'
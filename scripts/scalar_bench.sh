@@ -0,0 +1,28 @@
+#!/bin/sh
+# Build the simulation core once per scalar type (BOIDS_SCALAR) and compare boids_bench results.
+#
+# Every variant is built in $BUILD_ROOT/build-<scalar>.
+#
+# Usage: scripts/scalar_bench.sh [boids_bench arguments]
+# Extra CMake arguments can be passed with CMAKE_ARGS, e.g. CMAKE_ARGS=-DBOIDS_CORE_NATIVE=ON.
+
+set -e
+
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_ROOT=${BUILD_ROOT:-$SOURCE_DIR}
+SCALARS=${SCALARS:-"float double"}
+JOBS=${JOBS:-$(nproc)}
+
+for SCALAR in $SCALARS; do
+  echo "== $SCALAR build"
+  cmake -S "$SOURCE_DIR" -B "$BUILD_ROOT/build-$SCALAR" -DCMAKE_BUILD_TYPE=Release -DBOIDS_BUILD_VIEWER=OFF \
+    -DBOIDS_SCALAR="$SCALAR" $CMAKE_ARGS > /dev/null
+  cmake --build "$BUILD_ROOT/build-$SCALAR" -j"$JOBS" --target boids_bench > /dev/null
+done
+
+echo "== Benchmark"
+for SCALAR in $SCALARS; do
+  "$BUILD_ROOT/build-$SCALAR/boids_bench" "$@" |
+    awk -v scalar="$SCALAR" '/^update_ms_per_tick:/ { ms = $2 } /^update_min_ms_per_tick:/ { min = $2 }
+                             END { printf "%-8s %s ms/tick (min %s)\n", scalar ":", ms, min }'
+done
@@ -0,0 +1,69 @@
+#include <cstdlib>
+#include <new>
+#include "allocation_tracker.h"
+
+/**
+ * Counting replacement of the global operator new / delete, see allocation_tracker.h.
+ *
+ * Only linked into executables which want allocation counts, replacing operator new is a whole program decision.
+ */
+
+namespace {
+
+/** Runs before main, so allocation_tracking_enabled() is true from the start */
+const bool kInstalled = (allocation_hook::mark_installed(), true);
+
+void* allocate(std::size_t size) {
+  allocation_hook::record_allocation(size);
+  if (void* memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void* allocate(std::size_t size, const std::nothrow_t&) noexcept {
+  allocation_hook::record_allocation(size);
+  return std::malloc(size ? size : 1);
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+  return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t& tag) noexcept {
+  return allocate(size, tag);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+  return allocate(size, tag);
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  std::free(memory);
+}
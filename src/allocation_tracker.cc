@@ -0,0 +1,69 @@
+#include "allocation_tracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+/** Plain arrays of atomics, constant initialized so they work for allocations made before main */
+std::atomic<unsigned long> g_allocations[kAllocationPhaseCount];
+std::atomic<unsigned long> g_bytes[kAllocationPhaseCount];
+std::atomic<bool> g_installed(false);
+
+thread_local AllocationPhase t_phase = AllocationPhase::kOther;
+thread_local bool t_forbidden = false;
+
+}  // namespace
+
+bool allocation_tracking_enabled() {
+  return g_installed.load(std::memory_order_relaxed);
+}
+
+AllocationCounts allocation_counts(AllocationPhase phase) {
+  AllocationCounts counts;
+  counts.allocations = g_allocations[static_cast<std::size_t>(phase)].load(std::memory_order_relaxed);
+  counts.bytes = g_bytes[static_cast<std::size_t>(phase)].load(std::memory_order_relaxed);
+  return counts;
+}
+
+AllocationScope::AllocationScope(AllocationPhase phase, bool forbid_allocations)
+  : previous_phase_(t_phase),
+    previous_forbidden_(t_forbidden) {
+  t_phase = phase;
+  t_forbidden = forbid_allocations;
+}
+
+AllocationScope::~AllocationScope() {
+  t_phase = previous_phase_;
+  t_forbidden = previous_forbidden_;
+}
+
+AllocationPhase AllocationScope::current_phase() {
+  return t_phase;
+}
+
+bool AllocationScope::allocations_forbidden() {
+  return t_forbidden;
+}
+
+namespace allocation_hook {
+
+void mark_installed() {
+  g_installed.store(true, std::memory_order_relaxed);
+}
+
+void record_allocation(std::size_t size) {
+  const std::size_t kPhase = static_cast<std::size_t>(t_phase);
+  g_allocations[kPhase].fetch_add(1, std::memory_order_relaxed);
+  g_bytes[kPhase].fetch_add(size, std::memory_order_relaxed);
+#ifndef NDEBUG
+  if (t_forbidden) {
+    /** No iostreams, they may allocate */
+    std::fprintf(stderr, "Allocation of %zu bytes in a scope where allocations are forbidden\n", size);
+    std::abort();
+  }
+#endif
+}
+
+}  // namespace allocation_hook
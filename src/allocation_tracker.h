@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+/** Part of a frame allocations are attributed to */
+enum class AllocationPhase {
+  kOther,
+  /** Simulation step, update_boids and everything around it */
+  kSimulation,
+  /** Rendering, draw_boids and the HUD */
+  kDraw,
+};
+
+constexpr std::size_t kAllocationPhaseCount = 3;
+
+/** Allocations made so far */
+struct AllocationCounts {
+  unsigned long allocations = 0;
+  unsigned long bytes = 0;
+};
+
+/**
+ * Whether the counting global operator new (allocation_hook.cc) is linked in, all counts stay 0 otherwise.
+ *
+ * The hook is linked into boids and boids_bench with -DBOIDS_ALLOCATION_TRACKING=ON and always into
+ * boids_perf_test.
+ */
+bool allocation_tracking_enabled();
+
+/**
+ * Allocations attributed to given phase since start, summed over all threads.
+ *
+ * \param phase Phase.
+ * \return Counts.
+ */
+AllocationCounts allocation_counts(AllocationPhase phase);
+
+/**
+ * Attribute allocations made by the current thread (and by thread pool chunks it starts) to a phase while in scope.
+ *
+ * With allocations forbidden, any allocation in scope aborts in debug builds, which proves a hot loop stays off the
+ * heap.
+ */
+class AllocationScope {
+ public:
+  /**
+   * Enter scope.
+   *
+   * \param phase Phase allocations are attributed to.
+   * \param forbid_allocations Abort on allocation in debug builds.
+   */
+  explicit AllocationScope(AllocationPhase phase, bool forbid_allocations = false);
+  ~AllocationScope();
+
+  AllocationScope(const AllocationScope&) = delete;
+  AllocationScope& operator=(const AllocationScope&) = delete;
+
+  /** Phase of the current thread */
+  static AllocationPhase current_phase();
+  /** Whether allocations are forbidden on the current thread */
+  static bool allocations_forbidden();
+ private:
+  AllocationPhase previous_phase_;
+  bool previous_forbidden_;
+};
+
+/** Interface of the operator new hook, not meant to be called from anywhere else */
+namespace allocation_hook {
+
+void mark_installed();
+
+/**
+ * Count allocation of the current thread, must not allocate.
+ *
+ * \param size Requested size in bytes.
+ */
+void record_allocation(std::size_t size);
+
+}  // namespace allocation_hook
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "frame_arena.h"
+#include "perf_counters.h"
+#include "simulation.h"
+
+constexpr unsigned int kDefaultTicks = 300;
+constexpr unsigned int kWarmupTicks = 10;
+constexpr unsigned int kPredatorCount = 4;
+
+AppConfig bench_defaults() {
+  AppConfig config;
+  config.startup_boid_count = 20000;
+  config.world_width = 8000;
+  config.world_height = 6000;
+  /** Single thread by default, so results don't depend on the machine load */
+  config.threads = 1;
+  config.timestep = 1.0f / 60;
+  config.seed = 1;
+  return config;
+}
+
+Predators bench_predators(const Vector2u& world_size) {
+  Predators predators(kPredatorCount);
+  for (unsigned int i = 0; i < kPredatorCount; ++i) {
+    predators[i].position = Vector2s(world_size.x * (i + 1) / (kPredatorCount + 1), world_size.y / 2.0f);
+  }
+  return predators;
+}
+
+/** Steering difference between full precision and quantized neighbour scans */
+struct QuantizationError {
+  /** Target rotation error */
+  double mean_degrees = 0;
+  Scalar max_degrees = 0;
+  /** Boids which steered by flockmates in both runs, the others turn randomly or run from predators */
+  unsigned int compared_boids = 0;
+  /** Boids which saw a different number of flockmates, rounding moved one across a rule radius */
+  unsigned int neighbour_count_mismatches = 0;
+};
+
+/** Run the same state for a tick with and without quantized neighbour scans and compare steering */
+QuantizationError measure_quantization_error(const Boids& boids,
+                                             const Predators& predators,
+                                             float dt,
+                                             const Vector2u& world_size,
+                                             ThreadPool& thread_pool) {
+  Boid::Config config = Boid::config();
+  Boids full_precision = boids;
+  Boids quantized = boids;
+  SpatialGrid full_precision_grid;
+  SpatialGrid quantized_grid;
+  const bool kQuantized = config.quantized_neighbours;
+  config.quantized_neighbours = false;
+  Boid::set_config(config);
+  std::vector<unsigned int> full_precision_counts;
+  std::vector<unsigned int> quantized_counts;
+  update_boids(full_precision, full_precision_grid, predators, dt, world_size, thread_pool, nullptr,
+               &full_precision_counts);
+  config.quantized_neighbours = true;
+  Boid::set_config(config);
+  update_boids(quantized, quantized_grid, predators, dt, world_size, thread_pool, nullptr, &quantized_counts);
+  config.quantized_neighbours = kQuantized;
+  Boid::set_config(config);
+
+  QuantizationError error;
+  for (std::size_t i = 0; i < boids.size(); ++i) {
+    error.neighbour_count_mismatches += full_precision_counts[i] != quantized_counts[i];
+    if (full_precision_counts[i] == 0 || quantized_counts[i] == 0) {
+      continue;
+    }
+
+    const Scalar kDifference = std::abs(full_precision[i].target_rotation() - quantized[i].target_rotation());
+    const Scalar kError = std::min<Scalar>(kDifference, 360 - kDifference);
+    error.mean_degrees += kError;
+    error.max_degrees = std::max(error.max_degrees, kError);
+    ++error.compared_boids;
+  }
+  error.mean_degrees = error.compared_boids ? error.mean_degrees / error.compared_boids : 0;
+  return error;
+}
+
+/**
+ * Headless benchmark of the simulation core.
+ *
+ * Runs a canned, seeded workload through update_boids and reports its cost. Also used as the training
+ * workload for profile guided builds.
+ *
+ * Arguments:
+ *   --ticks=<n>  Number of measured ticks.
+ *   anything else is passed to the config loader, e.g. --simulation.startup_boid_count=50000
+ */
+int main(int argc, char* argv[]) {
+  unsigned int ticks = kDefaultTicks;
+  std::vector<char*> config_arguments = {argv[0]};
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--ticks=", 8) == 0) {
+      ticks = std::stoul(argv[i] + 8);
+    } else {
+      config_arguments.push_back(argv[i]);
+    }
+  }
+
+  const AppConfig kConfig = load_config(config_arguments.size(), config_arguments.data(), bench_defaults());
+  Boid::set_config(kConfig.boid);
+  FrameArena::set_initial_capacity(kConfig.arena_kb * std::size_t(1024));
+
+  const Vector2u kWorldSize = headless_world_size(kConfig);
+  const float kDt = kConfig.timestep > 0 ? kConfig.timestep : 1.0f / 60;
+  RandomGenerator random = make_random_generator(kConfig.seed);
+  Boids boids(kConfig.startup_boid_count);
+  randomize_boids(boids, kWorldSize, random);
+  const Predators kPredators = bench_predators(kWorldSize);
+  ThreadPool thread_pool(kConfig.threads);
+  SpatialGrid grid;
+  ObstacleField obstacle_field;
+  const Obstacles kObstacles = load_obstacle_field(kConfig, kWorldSize, thread_pool, obstacle_field);
+  Boid::set_obstacle_field(&obstacle_field);
+  FlowField flow_field;
+  reset_flow_field(kConfig, kWorldSize, obstacle_field, thread_pool, flow_field);
+  Boid::set_flow_field(&flow_field);
+
+  unsigned long tick = 0;
+  FrameArena& arena = FrameArena::for_current_thread();
+  const auto kStep = [&](UpdateMetrics* metrics) {
+    arena.reset();
+    if (kConfig.morton_sort_interval > 0 && tick % kConfig.morton_sort_interval == 0) {
+      sort_boids_spatially(boids, kWorldSize);
+    }
+    update_boids(boids, grid, kPredators, kDt, kWorldSize, thread_pool, metrics);
+    ++tick;
+  };
+
+  for (unsigned int i = 0; i < kWarmupTicks; ++i) {
+    kStep(nullptr);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  double total_ms = 0;
+  double min_ms = 0;
+  unsigned long total_reinsertions = 0;
+  /** Work counters are only gathered when asked for, they are not free */
+  const bool kGatherMetrics = !kConfig.metrics_file.empty();
+  UpdateMetrics metrics_totals;
+  UpdateMetrics metrics;
+  const AllocationCounts kAllocationsBefore = allocation_counts(AllocationPhase::kSimulation);
+  PerfCounters perf_counters;
+  perf_counters.start();
+  for (unsigned int i = 0; i < ticks; ++i) {
+    const Clock::time_point kStart = Clock::now();
+    metrics = UpdateMetrics();
+    {
+      /**
+       * Warmup sized every buffer, measured ticks must not touch the heap (checked in debug builds). Only open world
+       * grid rebuilds may, update_grid allows them.
+       */
+      AllocationScope allocation_scope(AllocationPhase::kSimulation, true);
+      kStep(kGatherMetrics ? &metrics : nullptr);
+    }
+    const double kTickMs = Milliseconds(Clock::now() - kStart).count();
+    total_ms += kTickMs;
+    min_ms = i == 0 ? kTickMs : std::min(min_ms, kTickMs);
+    total_reinsertions += grid.reinsertions();
+    metrics_totals += metrics;
+  }
+  perf_counters.stop();
+  const AllocationCounts kAllocationsAfter = allocation_counts(AllocationPhase::kSimulation);
+
+  if (kGatherMetrics) {
+    write_prometheus_metrics(kConfig.metrics_file, ticks, metrics_totals, metrics, grid_occupancy(grid));
+  }
+
+  const double kAverageMs = ticks ? total_ms / ticks : 0;
+  std::cout << "boids: " << boids.size() << "\n"
+            << "threads: " << thread_pool.thread_count() << "\n"
+            << "scalar: " << kScalarName << "\n"
+            << "ticks: " << ticks << "\n"
+            << "update_ms_per_tick: " << kAverageMs << "\n"
+            << "update_min_ms_per_tick: " << min_ms << "\n"
+            << "ticks_per_second: " << (kAverageMs > 0 ? 1000 / kAverageMs : 0) << "\n"
+            << "grid_reinsertions_per_tick: " << (ticks ? total_reinsertions / ticks : 0) << "\n"
+            << "morton_sort_interval: " << kConfig.morton_sort_interval << "\n"
+            << "arena_peak_bytes: " << arena.peak() << "\n"
+            << "quantized_neighbours: " << (kConfig.boid.quantized_neighbours ? "true" : "false") << "\n"
+            << "boundary: " << boundary_mode_name(kConfig.boid.boundary) << "\n"
+            << "obstacles: " << kObstacles.size() << "\n"
+            << "goals: " << kConfig.goals.size() << "\n";
+  if (kConfig.boid.quantized_neighbours) {
+    const QuantizationError kError = measure_quantization_error(boids, kPredators, kDt, kWorldSize, thread_pool);
+    std::cout << "quantized_position_step: " << grid.cell_size() / PackedBoids::kPositionSteps << "\n"
+              << "quantized_heading_error_mean_degrees: " << kError.mean_degrees << "\n"
+              << "quantized_heading_error_max_degrees: " << kError.max_degrees << "\n"
+              << "quantized_compared_boids: " << kError.compared_boids << "\n"
+              << "quantized_neighbour_count_mismatches: " << kError.neighbour_count_mismatches << "\n";
+  }
+  if (allocation_tracking_enabled()) {
+    std::cout << "allocations_per_tick: "
+              << (ticks ? (kAllocationsAfter.allocations - kAllocationsBefore.allocations) / ticks : 0) << "\n"
+              << "allocated_bytes_per_tick: "
+              << (ticks ? (kAllocationsAfter.bytes - kAllocationsBefore.bytes) / ticks : 0) << "\n";
+  }
+  for (PerfCounters::Counter counter : PerfCounters::counters()) {
+    std::cout << PerfCounters::name(counter) << "_per_tick: ";
+    if (perf_counters.available(counter)) {
+      std::cout << (ticks ? perf_counters.value(counter) / ticks : 0) << "\n";
+    } else {
+      std::cout << "unavailable\n";
+    }
+  }
+  return 0;
+}
@@ -1,31 +1,99 @@
 #include "boid.h"
 
+#include <algorithm>
+#include <array>
 #include <random>
+#include "spatial_grid.h"
 
-const Boid::Config Boid::kConfig_ = {};
+constexpr unsigned int Boid::kMaxTopologicalNeighbours;
 
-void Boid::update(const Boids& boids, const Predators& predators, float dt, const sf::Vector2u& window_size) {
-  /** Update position */
-  {
-    sf::Transform rotation;
-    rotation.rotate(rot_);
-    const float kDeltaMoveSpeed = move_speed_ * dt;
-    pos_ += rotation.transformPoint(0, -kDeltaMoveSpeed);
-    if (pos_.x < 0) {
-      pos_.x = window_size.x;
-    }
+namespace {
 
-    if (pos_.x > window_size.x) {
-      pos_.x = 0;
-    }
+/** Flock view over whole boids, which hold world positions, so the cell is not needed */
+class FullPrecisionFlock {
+ public:
+  explicit FullPrecisionFlock(const Boids& boids) : boids_(boids) {}
 
-    if (pos_.y < 0) {
-      pos_.y = window_size.y;
-    }
+  Vector2s position(unsigned int index, const Vector2s&) const {
+    return boids_[index].position();
+  }
 
-    if (pos_.y > window_size.y) {
-      pos_.y = 0;
-    }
+  Vector2s offset(unsigned int index, const Vector2s&, const Vector2s& origin) const {
+    return boids_[index].position() - origin;
+  }
+
+  Scalar rotation(unsigned int index) const {
+    return boids_[index].rotation();
+  }
+ private:
+  const Boids& boids_;
+};
+
+}  // namespace
+
+Boid::Config Boid::config_ = {};
+const ObstacleField* Boid::obstacle_field_ = nullptr;
+const FlowField* Boid::flow_field_ = nullptr;
+
+void Boid::set_config(const Config& config) {
+  config_ = config;
+}
+
+const Boid::Config& Boid::config() {
+  return config_;
+}
+
+void Boid::set_obstacle_field(const ObstacleField* field) {
+  obstacle_field_ = field && !field->empty() ? field : nullptr;
+}
+
+void Boid::set_flow_field(const FlowField* field) {
+  flow_field_ = field && !field->empty() ? field : nullptr;
+}
+
+template<class Boundary>
+unsigned int Boid::update(const Boids& boids,
+                          const SpatialGrid& grid,
+                          const Predators& predators,
+                          float dt,
+                          const Vector2u& world_size,
+                          UpdateMetrics* metrics) {
+  return update_from<Boundary>(FullPrecisionFlock(boids), grid, predators, dt, world_size, metrics);
+}
+
+template<class Boundary>
+unsigned int Boid::update(const PackedBoids& boids,
+                          const SpatialGrid& grid,
+                          const Predators& predators,
+                          float dt,
+                          const Vector2u& world_size,
+                          UpdateMetrics* metrics) {
+  return update_from<Boundary>(boids, grid, predators, dt, world_size, metrics);
+}
+
+template<class Boundary, class Flock>
+unsigned int Boid::update_from(const Flock& flock,
+                               const SpatialGrid& grid,
+                               const Predators& predators,
+                               float dt,
+                               const Vector2u& world_size,
+                               UpdateMetrics* metrics) {
+  /** Update position, the boundary policy keeps it in the world */
+  const Vector2s kWorldSize(world_size.x, world_size.y);
+  {
+    const Scalar kDeltaMoveSpeed = move_speed_ * dt;
+    pos_ = Boundary::move(pos_ + rotation_to_direction(rot_) * kDeltaMoveSpeed, rot_, target_rot_, kWorldSize);
+  }
+
+  /** Obstacles, one field lookup however many there are */
+  Vector2s obstacle_push;
+  if (obstacle_field_) {
+    const ObstacleField::Sample kObstacle = obstacle_field_->sample(pos_);
+    const Vector2s kAway = normalized(kObstacle.gradient);
+    /** Moved into an obstacle, back out to its outline */
+    pos_ -= kAway * std::min(kObstacle.distance, Scalar(0));
+    obstacle_push =
+      kAway * (std::max(Scalar(0), 1 - kObstacle.distance / config_.obstacle_distance) * config_.obstacle_weight);
   }
 
   /** Normalize rotations before calculation */
@@ -33,9 +101,9 @@ void Boid::update(const Boids& boids, const Predators& predators, float dt, cons
   target_rot_ = constraint_angle_0_360(target_rot_);
 
   {
-    float rotation_direction = 1;
+    Scalar rotation_direction = 1;
 
-    float rotation_delta = target_rot_ - rot_;
+    Scalar rotation_delta = target_rot_ - rot_;
 
     while(rotation_delta < 0) {
       rotation_delta += 360;
@@ -53,163 +121,209 @@ void Boid::update(const Boids& boids, const Predators& predators, float dt, cons
   target_rot_ = constraint_angle_0_360(target_rot_);
 
   /** Predators */
-  if (handle_predators(predators, dt)) {
-    return;
+  if (handle_predators<Boundary>(predators, dt, kWorldSize)) {
+    if (metrics) {
+      metrics->add_escaping_boid();
+    }
+    return 0;
   }
 
-  /** No predators, perform normal tasks */
+  /** No predators, steer by weighted sum of cohesion, alignment and separation, all gathered in one pass */
+  const Scalar kCohesionDistance = cohesion_distance();
+  Steering steering;
+  unsigned int tested = 0;
+  unsigned int neighbour_count = 0;
+  if (config_.topological_neighbours > 0) {
+    /** Topological mode, bounded work per boid however dense the flock is */
+    std::array<SpatialGrid::Neighbour, kMaxTopologicalNeighbours> nearest;
+    const unsigned int kCount =
+      grid.find_nearest<Boundary::kWraps>(pos_,
+                                          kCohesionDistance,
+                                          std::min(config_.topological_neighbours, kMaxTopologicalNeighbours),
+                                          [&](unsigned int index, const Vector2s& cell_origin) {
+                                            return flock.position(index, cell_origin);
+                                          },
+                                          nearest.data());
+    neighbour_count = kCount;
+    tested = kCount;
+    for (unsigned int i = 0; i < kCount; ++i) {
+      const unsigned int kIndex = nearest[i].index;
+      add_flockmate(Boundary::offset(flock.offset(kIndex, grid.cell_origin_of_boid(kIndex), pos_), kWorldSize),
+                    flock.rotation(kIndex),
+                    nearest[i].distance_squared,
+                    steering);
+    }
+  } else {
+    const Scalar kCohesionDistanceSquared = kCohesionDistance * kCohesionDistance;
+    const auto kVisit = [&](unsigned int index, const Vector2s& cell_origin) {
+      ++tested;
+      const Vector2s kOffset = Boundary::offset(flock.offset(index, cell_origin, pos_), kWorldSize);
+      const Scalar kDistanceSquared = kOffset.x * kOffset.x + kOffset.y * kOffset.y;
+      /** Zero distance is this boid (or one exactly on top of it, which gives no direction anyway) */
+      if (kDistanceSquared == 0 || kDistanceSquared >= kCohesionDistanceSquared) {
+        return;
+      }
+
+      add_flockmate(kOffset, flock.rotation(index), kDistanceSquared, steering);
+      ++neighbour_count;
+    };
+    grid.for_each_in_radius_by_cell<Boundary::kWraps>(pos_, kCohesionDistance, kVisit);
+  }
 
-  /** Cohesion */
-  const std::vector<Boid> kCohesionFlockmates = get_flockmates(boids, cohesion_distance());
-  /** If at this point there is only one flockmate (this boid) then there is nothing to do */
-  if (kCohesionFlockmates.size() == 1) {
-    target_rot_ = constraint_angle_0_360(target_rot_);
-    apply_rotation_jitter_if_needed(dt);
-    return;
-  }
-  const sf::Vector2f& kCohesionFlockmateCenterOfMass = center_of_mass(kCohesionFlockmates);
-
-  /** Alignment */
-  const std::vector<Boid> kAlignmentFlockmates = get_flockmates(kCohesionFlockmates, alignment_distance());
-  const sf::Vector2f& kAlignmentFlockmateCenterOfMass = center_of_mass(kAlignmentFlockmates);
-
-  /** Separation */
-  const std::vector<Boid> kSeparationFlockmates = get_flockmates(kAlignmentFlockmates, separation_distance());
-  const sf::Vector2f& kSeparationFlockmateCenterOfMass = center_of_mass(kSeparationFlockmates);
-
-  if (kSeparationFlockmates.size() > 1) {
-    const float kBoidToCenterOfMassRotation =
-      rad2deg(std::atan2(kSeparationFlockmateCenterOfMass.y - pos_.y,
-                         kSeparationFlockmateCenterOfMass.x - pos_.x));
-
-    target_rot_ = constraint_angle_0_360(kBoidToCenterOfMassRotation - 90);
-  } else if (kAlignmentFlockmates.size() > 1) {
-    const float kAverageRotation =
-      [&]{
-        using SinCosSum = std::tuple<float, float>;
-        SinCosSum sin_cos_sum =
-          std::accumulate(
-            kAlignmentFlockmates.begin(),
-            kAlignmentFlockmates.end(),
-            SinCosSum(0.0f, 0.0f),
-            [&](SinCosSum result, const auto& boid) {
-              const float kRad = deg2rad(boid.rot_);
-              std::get<0>(result) += std::sin(kRad);
-              std::get<1>(result) += std::cos(kRad);
-              return result;
-            }
-          );
-
-        return rad2deg(std::atan2(std::get<0>(sin_cos_sum), std::get<1>(sin_cos_sum)));
-      }();
-    target_rot_ = constraint_angle_0_360(kAverageRotation);
+  if (metrics) {
+    metrics->add_boid(tested, neighbour_count, steering.alignment_count, steering.separation_count);
+  }
+
+  /** Turn away from walls (a constant zero the compiler drops for boundaries without them) and obstacles */
+  Vector2s steering_sum =
+    Boundary::wall_push(pos_, kWorldSize, config_.wall_margin) * Scalar(config_.wall_weight) + obstacle_push;
+  /** Towards the closest goal, one field lookup instead of a path search */
+  if (flow_field_) {
+    steering_sum += flow_field_->sample(pos_) * Scalar(config_.goal_weight);
+  }
+
+  /** No flockmates, goals and no wall or obstacle close, nothing to do */
+  if (steering.cohesion_weight_sum == 0 && steering_sum == Vector2s()) {
     apply_rotation_jitter_if_needed(dt);
-  } else if (kCohesionFlockmates.size() > 1) {
-    const float kBoidToCenterOfMassRotation =
-      rad2deg(std::atan2(kCohesionFlockmateCenterOfMass.y - pos_.y, kCohesionFlockmateCenterOfMass.x - pos_.x));
+    return neighbour_count;
+  }
 
-    target_rot_ = constraint_angle_0_360(kBoidToCenterOfMassRotation + 90);
+  if (steering.cohesion_weight_sum > 0) {
+    steering_sum +=
+      normalized(steering.cohesion_offset / steering.cohesion_weight_sum) * Scalar(config_.cohesion_weight) +
+      normalized(steering.alignment_heading) * Scalar(config_.alignment_weight) +
+      normalized(steering.separation) * Scalar(config_.separation_weight);
   }
 
+  if (steering_sum != Vector2s()) {
+    target_rot_ = direction_to_rotation(steering_sum);
+  }
+  return neighbour_count;
 }
 
-sf::Vector2f Boid::position() const {
+Vector2s Boid::position() const {
   return pos_;
 }
 
-float Boid::rotation() const {
+Scalar Boid::rotation() const {
   return rot_;
 }
 
-sf::Color Boid::color() const {
-  return col_;
+Scalar Boid::target_rotation() const {
+  return target_rot_;
 }
 
 int Boid::size() const {
-  return kConfig_.kSize;
+  return config_.size;
 }
 
 int Boid::cohesion_distance() const {
-  return kConfig_.kSize * kConfig_.kCohesionDistanceFactor;
+  return config_.size * config_.cohesion_distance_factor;
 }
 
 int Boid::alignment_distance() const {
-  return kConfig_.kSize * kConfig_.kAlignmentDistanceFactor;
+  return config_.size * config_.alignment_distance_factor;
 }
 
 int Boid::separation_distance() const {
-  return kConfig_.kSize * kConfig_.kSeparationDistanceFactor;
-}
-
-Predators Boid::get_local_predators(const Predators& predators, int distance) const {
-  Predators result;
-  std::copy_if(predators.begin(), predators.end(), std::back_inserter(result), [&](const auto& predator) {
-    return distance_2d(pos_, predator.position) < distance + predator.size;
-  });
-  return result;
-}
-
-sf::Vector2f Boid::center_of_mass(const Predators& predators) const {
-  return std::accumulate(
-    predators.begin(),
-    predators.end(),
-    sf::Vector2f(),
-    [&](auto result, const auto& predator) {
-      result.x += predator.position.x / predators.size();
-      result.y += predator.position.y / predators.size();
-      return result;
-    }
-  );
+  return config_.size * config_.separation_distance_factor;
 }
 
-bool Boid::handle_predators(const Predators& predators, float dt) {
+void Boid::add_flockmate(const Vector2s& offset, Scalar rotation, Scalar distance_squared, Steering& steering) const {
+  const Scalar kDistance = std::sqrt(distance_squared);
+  const Scalar kCohesionWeight = steering_falloff(kDistance, cohesion_distance());
+  steering.cohesion_offset += offset * kCohesionWeight;
+  steering.cohesion_weight_sum += kCohesionWeight;
+
+  const Scalar kAlignmentDistance = alignment_distance();
+  if (kDistance < kAlignmentDistance) {
+    steering.alignment_heading +=
+      rotation_to_direction(rotation) * steering_falloff(kDistance, kAlignmentDistance);
+    ++steering.alignment_count;
+  }
+
+  const Scalar kSeparationDistance = separation_distance();
+  if (kDistance < kSeparationDistance) {
+    steering.separation -= offset * (steering_falloff(kDistance, kSeparationDistance) / kDistance);
+    ++steering.separation_count;
+  }
+}
+
+Scalar Boid::steering_falloff(Scalar distance, Scalar radius) {
+  /** Exponent is the same for every boid, so the branches are perfectly predicted */
+  const Scalar kProximity = 1 - distance / radius;
+  if (config_.steering_falloff == 1) {
+    return kProximity;
+  }
+  if (config_.steering_falloff == 0) {
+    return 1;
+  }
+  return std::pow(kProximity, config_.steering_falloff);
+}
+
+template<class Boundary>
+bool Boid::handle_predators(const Predators& predators, float dt, const Vector2s& world_size) {
   const int kPredatorDetectionDistance = alignment_distance();
-  const Predators& kLocalPredators = get_local_predators(predators, kPredatorDetectionDistance);
-  if (!kLocalPredators.empty()) {
-    const sf::Vector2f& kPreadtorsCenterOfMass = center_of_mass(kLocalPredators);
-    const float kBoidToCenterOfMassRotation =
-      rad2deg(std::atan2(kPreadtorsCenterOfMass.y - pos_.y,
-                         kPreadtorsCenterOfMass.x - pos_.x));
+  /**
+   * Center of mass of the local predators relative to this boid, so predators across a wrapping world edge count
+   * too. Summed in place so the update loop stays off the heap.
+   */
+  Vector2s local_predators_offset_sum;
+  unsigned int local_predator_count = 0;
+  for (const auto& predator : predators) {
+    const Vector2s kOffset = Boundary::offset(predator.position - pos_, world_size);
+    if (length(kOffset) < kPredatorDetectionDistance + predator.size) {
+      local_predators_offset_sum += kOffset;
+      ++local_predator_count;
+    }
+  }
+
+  if (local_predator_count > 0) {
+    const Vector2s kPreadtorsCenterOfMassOffset =
+      local_predators_offset_sum / static_cast<Scalar>(local_predator_count);
+    const Scalar kBoidToCenterOfMassRotation =
+      rad2deg(std::atan2(kPreadtorsCenterOfMassOffset.y, kPreadtorsCenterOfMassOffset.x));
 
     target_rot_ = kBoidToCenterOfMassRotation - 90;
     /** Run away from the predator */
-    const float kFearFactor =
-      1 - std::min(1.0f, distance_2d(kPreadtorsCenterOfMass, pos_) / kPredatorDetectionDistance);
-    const float kPredatorMoveSpeed =
-      std::min(kConfig_.kDefaultMoveSpeed + (kConfig_.kPredatorEscapeMoveSpeed * kFearFactor),
-               kConfig_.kPredatorEscapeMoveSpeed);
+    const Scalar kFearFactor =
+      1 - std::min<Scalar>(1, length(kPreadtorsCenterOfMassOffset) / kPredatorDetectionDistance);
+    const Scalar kPredatorMoveSpeed =
+      std::min<Scalar>(config_.default_move_speed + (config_.predator_escape_move_speed * kFearFactor),
+                       config_.predator_escape_move_speed);
 
     move_speed_ = std::max(move_speed_, kPredatorMoveSpeed);
 
-    const float kPredatorRotationSpeed =
-      std::min(kConfig_.kDefaultMoveSpeed + (kConfig_.kPredatorEscapeRotationSpeed * kFearFactor),
-               kConfig_.kPredatorEscapeRotationSpeed);
+    const Scalar kPredatorRotationSpeed =
+      std::min<Scalar>(config_.default_move_speed + (config_.predator_escape_rotation_speed * kFearFactor),
+                       config_.predator_escape_rotation_speed);
 
     rotation_speed_ = std::max(rotation_speed_, kPredatorRotationSpeed);
 
     return true;
   } else {
     /** No predator, decelerate if needed */
-    if (move_speed_ > kConfig_.kDefaultMoveSpeed) {
-      move_speed_ -= kConfig_.kPredatorEscapeMoveSpeed * dt;
+    if (move_speed_ > config_.default_move_speed) {
+      move_speed_ -= config_.predator_escape_move_speed * dt;
     }
 
-    move_speed_= std::max(move_speed_, kConfig_.kDefaultMoveSpeed);
+    move_speed_= std::max<Scalar>(move_speed_, config_.default_move_speed);
 
-    if (rotation_speed_ > kConfig_.kDefaultRotationSpeed) {
-      rotation_speed_ -= kConfig_.kPredatorEscapeRotationSpeed * dt;
+    if (rotation_speed_ > config_.default_rotation_speed) {
+      rotation_speed_ -= config_.predator_escape_rotation_speed * dt;
     }
 
-    rotation_speed_= std::max(rotation_speed_, kConfig_.kDefaultRotationSpeed);
+    rotation_speed_= std::max<Scalar>(rotation_speed_, config_.default_rotation_speed);
   }
 
   return false;
 }
 
 void Boid::apply_rotation_jitter_if_needed(float dt) {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::uniform_int_distribution<> random_rotation_jitter(-45, 45);
+  /** Boids are updated from several threads, every thread keeps its own generator */
+  static thread_local std::random_device rd;
+  static thread_local std::mt19937 gen(rd());
+  static thread_local std::uniform_int_distribution<> random_rotation_jitter(-45, 45);
   last_time_rotation_jitter_applied_accumulator += dt;
 
   /** For now always apply jitter */
@@ -218,3 +332,21 @@ void Boid::apply_rotation_jitter_if_needed(float dt) {
     last_time_rotation_jitter_applied_accumulator = 0;
   }
 }
+
+/** Every boundary policy, with_boundary picks one per update_boids call */
+template unsigned int Boid::update<WrapBoundary>(const Boids&, const SpatialGrid&, const Predators&,
+                                                 float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<WrapBoundary>(const PackedBoids&, const SpatialGrid&, const Predators&,
+                                                 float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<ReflectBoundary>(const Boids&, const SpatialGrid&, const Predators&,
+                                                    float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<ReflectBoundary>(const PackedBoids&, const SpatialGrid&, const Predators&,
+                                                    float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<SoftWallBoundary>(const Boids&, const SpatialGrid&, const Predators&,
+                                                     float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<SoftWallBoundary>(const PackedBoids&, const SpatialGrid&, const Predators&,
+                                                     float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<OpenBoundary>(const Boids&, const SpatialGrid&, const Predators&,
+                                                 float, const Vector2u&, UpdateMetrics*);
+template unsigned int Boid::update<OpenBoundary>(const PackedBoids&, const SpatialGrid&, const Predators&,
+                                                 float, const Vector2u&, UpdateMetrics*);
@@ -1,99 +1,215 @@
 #pragma once
 
 #include <vector>
-#include <numeric>
-#include <SFML/Graphics.hpp>
+#include "boundary.h"
+#include "color.h"
+#include "metrics.h"
+#include "flow_field.h"
+#include "obstacles.h"
+#include "packed_boids.h"
 #include "predator.h"
 #include "utils.h"
+#include "scalar.h"
 
 class Boid;
 using Boids = std::vector<Boid>;
+class SpatialGrid;
 
+/**
+ * Boid data only rendering and selection look at, stored apart from Boid at the same index, so the state every
+ * update copies and every neighbour scan reads stays small.
+ */
+struct BoidAppearance {
+  Color color = Color(255, 255, 255);
+  /** Selected for debug drawing */
+  bool debug_selected = false;
+};
+
+using BoidAppearances = std::vector<BoidAppearance>;
+
+/** Simulation state of a boid, everything here is read or written by the update */
 class Boid {
  public:
   Boid() = default;
-  Boid(const sf::Vector2f& pos, float rot, const sf::Color& col)
+  Boid(const Vector2s& pos, Scalar rot)
     : pos_(pos),
       rot_(rot),
-      target_rot_(rot),
-      col_(col) {}
+      target_rot_(rot) {}
 
   /**
    * Update boid.
    *
+   * Instantiated for every boundary policy in boundary.h, see with_boundary.
+   *
+   * /tparam Boundary Boundary policy, should match Config::boundary.
    * /param boids All boids.
+   * /param grid Spatial grid built from boids.
+   * /param predators Predators.
+   * /param dt Delta time in seconds.
+   * /param world_size World size.
+   * /param metrics Work counters to add to, nullptr means not measured.
+   * /return Number of flockmates steered by, the work done for this boid is roughly proportional.
+   */
+  template<class Boundary>
+  unsigned int update(const Boids& boids,
+                      const SpatialGrid& grid,
+                      const Predators& predators,
+                      float dt,
+                      const Vector2u& world_size,
+                      UpdateMetrics* metrics = nullptr);
+
+  /**
+   * Update boid, reading flockmates from their packed copy.
+   *
+   * /tparam Boundary Boundary policy, should match Config::boundary.
+   * /param boids All boids packed, with the same indices as in the grid.
+   * /param grid Spatial grid built from boids.
    * /param predators Predators.
    * /param dt Delta time in seconds.
-   * /param window_size Window size.
+   * /param world_size World size.
+   * /param metrics Work counters to add to, nullptr means not measured.
+   * /return Number of flockmates steered by.
+   */
+  template<class Boundary>
+  unsigned int update(const PackedBoids& boids,
+                      const SpatialGrid& grid,
+                      const Predators& predators,
+                      float dt,
+                      const Vector2u& world_size,
+                      UpdateMetrics* metrics = nullptr);
+
+  /** Boid config options, kept flat so the update loop reads it without any lookups */
+  struct Config {
+    int size = 10;
+    float default_move_speed = 200;
+    float predator_escape_move_speed = 4 * default_move_speed;
+    float default_rotation_speed = 360;
+    float predator_escape_rotation_speed = 4 * default_rotation_speed;
+    int separation_distance_factor = 2;
+    int alignment_distance_factor = 7;
+    int cohesion_distance_factor = 20;
+    /** Weights of the steering rules, all rules are combined every update */
+    float cohesion_weight = 1;
+    float alignment_weight = 1;
+    float separation_weight = 1.5f;
+    /** Exponent of the (1 - distance / radius) neighbour weight, 0 means all neighbours weigh the same */
+    float steering_falloff = 1;
+    /** Topological mode, only this many nearest flockmates within cohesion distance are considered, 0 means all */
+    unsigned int topological_neighbours = 0;
+    /** Neighbour scans read 16 bit fixed point positions and headings (PackedBoids) instead of whole boids */
+    bool quantized_neighbours = false;
+    /** What happens at the world edges */
+    BoundaryMode boundary = BoundaryMode::kWrap;
+    /** Soft wall boundary, distance from the edges boids start turning away at and weight of the turn */
+    float wall_margin = 200;
+    float wall_weight = 2;
+    /** Distance from obstacles boids start turning away at (positive) and weight of the turn */
+    float obstacle_distance = 100;
+    float obstacle_weight = 3;
+    /** Weight of the turn towards the closest goal (FlowField) against flocking */
+    float goal_weight = 1;
+  };
+
+  /** Upper bound of Config::topological_neighbours */
+  static constexpr unsigned int kMaxTopologicalNeighbours = 64;
+
+  /**
+   * Set config shared by all boids, must not be called while boids are updated.
+   *
+   * \param config Config.
+   */
+  static void set_config(const Config& config);
+  static const Config& config();
+
+  /**
+   * Set obstacles shared by all boids, must not be called while boids are updated.
+   *
+   * \param field Baked obstacles, nullptr means none. Has to outlive the updates.
+   */
+  static void set_obstacle_field(const ObstacleField* field);
+
+  /**
+   * Set goals shared by all boids, must not be called while boids are updated.
+   *
+   * \param field Directions towards the goals, nullptr or an empty field means none. Has to outlive the updates.
    */
-  void update(const Boids& boids, const Predators& predators, float dt, const sf::Vector2u& window_size);
+  static void set_flow_field(const FlowField* field);
 
-  sf::Vector2f position() const;
-  float rotation() const;
-  sf::Color color() const;
+  Vector2s position() const;
+  Scalar rotation() const;
+  /** Rotation the boid turns towards, set by steering */
+  Scalar target_rotation() const;
   int size() const;
   int cohesion_distance() const;
   int alignment_distance() const;
   int separation_distance() const;
  private:
-  /** Boid config options */
-  struct Config {
-    const int kSize = 10;
-    const float kDefaultMoveSpeed = 200;
-    const float kPredatorEscapeMoveSpeed = 4 * kDefaultMoveSpeed;
-    const float kDefaultRotationSpeed = 360;
-    const float kPredatorEscapeRotationSpeed = 4 * kDefaultRotationSpeed;
-    const int kSeparationDistanceFactor = 2;
-    const int kAlignmentDistanceFactor = 7;
-    const int kCohesionDistanceFactor = 20;
+  /**
+   * Update boid, shared by the full precision and the packed flock.
+   *
+   * \param flock Flockmates, provides position(index, cell_origin), offset(index, cell_origin, origin) and
+   *              rotation(index).
+   */
+  template<class Boundary, class Flock>
+  unsigned int update_from(const Flock& flock,
+                           const SpatialGrid& grid,
+                           const Predators& predators,
+                           float dt,
+                           const Vector2u& world_size,
+                           UpdateMetrics* metrics);
+
+  /**
+   * Weight of a flockmate at given distance, falls from 1 (same position) to 0 (radius).
+   *
+   * \param distance Distance to the flockmate.
+   * \param radius Rule radius.
+   * \return Weight.
+   */
+  static Scalar steering_falloff(Scalar distance, Scalar radius);
+
+  /** Steering rule sums gathered from the flockmates */
+  struct Steering {
+    /** Weighted sum of flockmate offsets, relative to this boid so far away worlds don't lose precision */
+    Vector2s cohesion_offset;
+    Scalar cohesion_weight_sum = 0;
+    Vector2s alignment_heading;
+    Vector2s separation;
+    unsigned int alignment_count = 0;
+    unsigned int separation_count = 0;
   };
 
-  Predators get_local_predators(const Predators& predators, int distance) const;
-
-  template<class T>
-  Boids get_flockmates(const T& boids, int distance) const {
-      std::vector<Boid> result;
-      std::copy_if(boids.begin(), boids.end(), std::back_inserter(result), [&](const auto& local_flockmate) {
-        return distance_2d(pos_, local_flockmate.pos_) < distance;
-      });
-      return result;
-  }
-
-  template<class T>
-  sf::Vector2f center_of_mass(const T& boids) const {
-    return std::accumulate(
-      boids.begin(),
-      boids.end(),
-      sf::Vector2f(),
-      [&](auto result, const auto& local_flockmate) {
-        result.x += local_flockmate.pos_.x / boids.size();
-        result.y += local_flockmate.pos_.y / boids.size();
-        return result;
-      }
-    );
-  }
-
-  sf::Vector2f center_of_mass(const Predators& predators) const;
+  /**
+   * Add flockmate to the steering sums.
+   *
+   * \param offset Flockmate position relative to this boid.
+   * \param rotation Flockmate rotation.
+   * \param distance_squared Squared distance to the flockmate, non zero and below cohesion distance.
+   * \param steering Steering sums.
+   */
+  void add_flockmate(const Vector2s& offset, Scalar rotation, Scalar distance_squared, Steering& steering) const;
 
   /**
    * Handle predators.
    *
    * \param preadators Predators
    * \param dt Delta time in seconds.
+   * \param world_size World size, offsets to predators are measured by the boundary policy.
    * \return True if some predators were detected and some actions performed, false otherwise.
    */
-  bool handle_predators(const Predators& predators, float dt);
+  template<class Boundary>
+  bool handle_predators(const Predators& predators, float dt, const Vector2s& world_size);
 
   void apply_rotation_jitter_if_needed(float dt);
 
-  static const Config kConfig_;
+  static Config config_;
+  static const ObstacleField* obstacle_field_;
+  static const FlowField* flow_field_;
 
-  sf::Vector2f pos_;
-  float rot_ = 0;
-  float target_rot_ = 0;
-  sf::Color col_ = sf::Color::White;
-  float move_speed_ = kConfig_.kDefaultMoveSpeed;
-  float rotation_speed_ = kConfig_.kDefaultRotationSpeed;
-  float last_time_rotation_jitter_applied_accumulator = 0;
+  Vector2s pos_;
+  Scalar rot_ = 0;
+  Scalar target_rot_ = 0;
+  Scalar move_speed_ = config_.default_move_speed;
+  Scalar rotation_speed_ = config_.default_rotation_speed;
+  Scalar last_time_rotation_jitter_applied_accumulator = 0;
 };
 
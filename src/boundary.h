@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include "scalar.h"
+#include "utils.h"
+
+/** What happens to boids at the world edges, picked per run */
+enum class BoundaryMode {
+  /** Boids leaving on one side come back on the opposite one, neighbours are seen across the edges */
+  kWrap,
+  /** Edges are mirrors, boids bounce off them */
+  kReflect,
+  /** Boids are steered away from the edges within a margin and stopped at them */
+  kSoftWall,
+  /** No edges, the flock may spread without limit */
+  kOpen,
+};
+
+/**
+ * Boundary policies, Boid::update is instantiated once per policy so the update loop has no boundary branches.
+ *
+ * Every policy provides:
+ *   kWraps                                    Neighbour search wraps around the world.
+ *   move(position, rotation, target_rotation, world_size)
+ *                                             Position after a move, may turn the boid.
+ *   offset(offset, world_size)                Offset between two boids as seen by the flocking rules.
+ *   wall_push(position, world_size, margin)   Push away from the edges, 0 to 1 per axis.
+ */
+struct WrapBoundary {
+  static constexpr bool kWraps = true;
+
+  static Vector2s move(const Vector2s& position, Scalar&, Scalar&, const Vector2s& world_size) {
+    return wrap_position(position, world_size);
+  }
+
+  static Vector2s offset(const Vector2s& offset, const Vector2s& world_size) {
+    return toroidal_offset(offset, world_size);
+  }
+
+  static Vector2s wall_push(const Vector2s&, const Vector2s&, Scalar) {
+    return Vector2s();
+  }
+};
+
+struct ReflectBoundary {
+  static constexpr bool kWraps = false;
+
+  static Vector2s move(const Vector2s& position,
+                       Scalar& rotation,
+                       Scalar& target_rotation,
+                       const Vector2s& world_size) {
+    /** Mirrored at both edges, valid up to one world size outside of it like wrap_coordinate */
+    const Vector2s kReflected(world_size.x - std::abs(world_size.x - std::abs(position.x)),
+                              world_size.y - std::abs(world_size.y - std::abs(position.y)));
+    /** Rotation 0 faces negative y, a mirror across a vertical edge negates it, across a horizontal one 180 - it */
+    const bool kFlipX = kReflected.x != position.x;
+    const bool kFlipY = kReflected.y != position.y;
+    rotation = kFlipX ? -rotation : rotation;
+    rotation = kFlipY ? 180 - rotation : rotation;
+    target_rotation = kFlipX ? -target_rotation : target_rotation;
+    target_rotation = kFlipY ? 180 - target_rotation : target_rotation;
+    return kReflected;
+  }
+
+  static Vector2s offset(const Vector2s& offset, const Vector2s&) {
+    return offset;
+  }
+
+  static Vector2s wall_push(const Vector2s&, const Vector2s&, Scalar) {
+    return Vector2s();
+  }
+};
+
+struct SoftWallBoundary {
+  static constexpr bool kWraps = false;
+
+  static Vector2s move(const Vector2s& position, Scalar&, Scalar&, const Vector2s& world_size) {
+    return Vector2s(std::min(std::max(position.x, Scalar(0)), world_size.x),
+                    std::min(std::max(position.y, Scalar(0)), world_size.y));
+  }
+
+  static Vector2s offset(const Vector2s& offset, const Vector2s&) {
+    return offset;
+  }
+
+  static Vector2s wall_push(const Vector2s& position, const Vector2s& world_size, Scalar margin) {
+    /** Grows linearly from 0 at margin from an edge to 1 at the edge, opposite edges cancel out where they overlap */
+    const Scalar kInverseMargin = margin > 0 ? 1 / margin : 0;
+    return Vector2s(std::max(Scalar(0), 1 - position.x * kInverseMargin) -
+                      std::max(Scalar(0), 1 - (world_size.x - position.x) * kInverseMargin),
+                    std::max(Scalar(0), 1 - position.y * kInverseMargin) -
+                      std::max(Scalar(0), 1 - (world_size.y - position.y) * kInverseMargin));
+  }
+};
+
+struct OpenBoundary {
+  static constexpr bool kWraps = false;
+
+  static Vector2s move(const Vector2s& position, Scalar&, Scalar&, const Vector2s&) {
+    return position;
+  }
+
+  static Vector2s offset(const Vector2s& offset, const Vector2s&) {
+    return offset;
+  }
+
+  static Vector2s wall_push(const Vector2s&, const Vector2s&, Scalar) {
+    return Vector2s();
+  }
+};
+
+/**
+ * Call function with the policy of given mode, so the caller is instantiated once per policy and the mode is only
+ * looked at once.
+ *
+ * \param mode Boundary mode.
+ * \param function Generic function taking the policy (an empty struct) by value.
+ */
+template<class Function>
+void with_boundary(BoundaryMode mode, Function function) {
+  switch (mode) {
+    case BoundaryMode::kWrap:
+      function(WrapBoundary());
+      return;
+    case BoundaryMode::kReflect:
+      function(ReflectBoundary());
+      return;
+    case BoundaryMode::kSoftWall:
+      function(SoftWallBoundary());
+      return;
+    case BoundaryMode::kOpen:
+      function(OpenBoundary());
+      return;
+  }
+}
+
+inline const char* boundary_mode_name(BoundaryMode mode) {
+  switch (mode) {
+    case BoundaryMode::kWrap:
+      return "wrap";
+    case BoundaryMode::kReflect:
+      return "reflect";
+    case BoundaryMode::kSoftWall:
+      return "soft_wall";
+    case BoundaryMode::kOpen:
+      return "open";
+  }
+  return "";
+}
+
+/** Inverse of boundary_mode_name, throws std::invalid_argument for unknown names */
+inline BoundaryMode boundary_mode_from_name(const std::string& name) {
+  for (const BoundaryMode kMode : {BoundaryMode::kWrap, BoundaryMode::kReflect, BoundaryMode::kSoftWall,
+                                   BoundaryMode::kOpen}) {
+    if (name == boundary_mode_name(kMode)) {
+      return kMode;
+    }
+  }
+  throw std::invalid_argument(name);
+}
@@ -0,0 +1,173 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "boundary.h"
+#include "frame_arena.h"
+#include "simulation.h"
+
+namespace {
+
+constexpr float kDt = 1.0f / 60;
+constexpr unsigned int kTicks = 600;
+constexpr unsigned int kBoidCount = 500;
+
+int failures = 0;
+
+void fail(const std::string& scenario, const std::string& message) {
+  ++failures;
+  std::cerr << scenario << ": " << message << "\n";
+}
+
+std::string to_string(const Vector2s& position) {
+  return "(" + std::to_string(position.x) + ", " + std::to_string(position.y) + ")";
+}
+
+bool inside(const Vector2s& position, const Vector2s& world_size) {
+  return position.x >= 0 && position.x <= world_size.x && position.y >= 0 && position.y <= world_size.y;
+}
+
+/**
+ * Run a flock with given boundary, calling check with the boids after every tick until it returns false.
+ *
+ * Boids are fast compared to the world, so they reach the edges many times.
+ */
+template<class Check>
+void run_flock(BoundaryMode boundary, const Vector2u& world_size, Check check) {
+  Boid::Config config;
+  config.boundary = boundary;
+  config.default_move_speed = 600;
+  /** Boids take the move speed of the config they are created with */
+  Boid::set_config(config);
+
+  RandomGenerator random = make_random_generator(3);
+  Boids boids(kBoidCount);
+  randomize_boids(boids, world_size, random);
+  /** A predator in the middle drives the flock towards the edges at escape speed */
+  Predators predators(1);
+  predators[0].position = Vector2s(world_size.x / 2.0f, world_size.y / 2.0f);
+  ThreadPool thread_pool(1);
+  SpatialGrid grid;
+  for (unsigned int tick = 0; tick < kTicks; ++tick) {
+    FrameArena::for_current_thread().reset();
+    update_boids(boids, grid, predators, kDt, world_size, thread_pool);
+    if (!check(boids, grid, tick)) {
+      return;
+    }
+  }
+}
+
+/** Moves across every edge and corner by several distances, the heading has to come back mirrored */
+void test_reflect_move() {
+  const Vector2s kWorldSize(1000, 800);
+  std::mt19937 random(4);
+  std::uniform_real_distribution<Scalar> rotation(0, 360);
+  std::uniform_real_distribution<Scalar> overshoot(Scalar(0.01), 300);
+  for (int i = 0; i < 2000; ++i) {
+    /** -1 before the first edge, 0 inside, 1 past the second edge */
+    const int kSideX = i % 3 - 1;
+    const int kSideY = i / 3 % 3 - 1;
+    const Vector2s kPosition(kSideX < 0 ? -overshoot(random) : (kSideX > 0 ? kWorldSize.x + overshoot(random) : 500),
+                             kSideY < 0 ? -overshoot(random) : (kSideY > 0 ? kWorldSize.y + overshoot(random) : 400));
+    const Scalar kRotation = rotation(random);
+    Scalar reflected_rotation = kRotation;
+    Scalar reflected_target_rotation = kRotation;
+    const Vector2s kReflected =
+      ReflectBoundary::move(kPosition, reflected_rotation, reflected_target_rotation, kWorldSize);
+
+    const std::string kName = "reflect move " + to_string(kPosition);
+    if (!inside(kReflected, kWorldSize)) {
+      fail(kName, "ended outside at " + to_string(kReflected));
+    }
+    /** Mirrored across vertical edges the x part of the heading flips, across horizontal ones the y part */
+    const Vector2s kDirection = rotation_to_direction(kRotation);
+    const Vector2s kExpected(kSideX != 0 ? -kDirection.x : kDirection.x, kSideY != 0 ? -kDirection.y : kDirection.y);
+    const Vector2s kHeading = rotation_to_direction(reflected_rotation);
+    const Vector2s kTargetHeading = rotation_to_direction(reflected_target_rotation);
+    if (length(kHeading - kExpected) > Scalar(1e-3) || length(kTargetHeading - kExpected) > Scalar(1e-3)) {
+      fail(kName, "heading " + std::to_string(kRotation) + " became " + std::to_string(reflected_rotation) +
+                  ", not mirrored");
+    }
+  }
+}
+
+void test_reflect_flock() {
+  const Vector2u kWorld(1000, 800);
+  const Vector2s kWorldSize(kWorld.x, kWorld.y);
+  run_flock(BoundaryMode::kReflect, kWorld, [&](const Boids& boids, const SpatialGrid&, unsigned int tick) {
+    for (const Boid& kBoid : boids) {
+      if (!inside(kBoid.position(), kWorldSize)) {
+        fail("reflect flock", "tick " + std::to_string(tick) + ": boid outside at " + to_string(kBoid.position()));
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void test_soft_wall_flock() {
+  const Vector2u kWorld(1000, 800);
+  const Vector2s kWorldSize(kWorld.x, kWorld.y);
+  run_flock(BoundaryMode::kSoftWall, kWorld, [&](const Boids& boids, const SpatialGrid&, unsigned int tick) {
+    for (const Boid& kBoid : boids) {
+      if (!inside(kBoid.position(), kWorldSize)) {
+        fail("soft wall flock", "tick " + std::to_string(tick) + ": boid crossed the wall to " +
+                                to_string(kBoid.position()));
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+/** Boids leave the world, none may get lost, the grid has to hold every one of them */
+void test_open_flock() {
+  const Vector2u kWorld(1000, 800);
+  bool left_world = false;
+  run_flock(BoundaryMode::kOpen, kWorld, [&](const Boids& boids, const SpatialGrid& grid, unsigned int tick) {
+    const std::string kName = "open flock tick " + std::to_string(tick);
+    if (boids.size() != kBoidCount) {
+      fail(kName, std::to_string(boids.size()) + " boids, expected " + std::to_string(kBoidCount));
+      return false;
+    }
+
+    unsigned int gridded = 0;
+    const Vector2s kGridMax = grid.origin() + Vector2s(grid.size().x, grid.size().y);
+    grid.for_each_cell_in_rect(grid.origin(), kGridMax, [&](const Vector2s&, Scalar, unsigned int count) {
+      gridded += count;
+    });
+    for (const Boid& kBoid : boids) {
+      const Vector2s kPosition = kBoid.position();
+      if (!std::isfinite(kPosition.x) || !std::isfinite(kPosition.y)) {
+        fail(kName, "boid at " + to_string(kPosition));
+        return false;
+      }
+      left_world = left_world || !inside(kPosition, Vector2s(kWorld.x, kWorld.y));
+    }
+    if (gridded != kBoidCount) {
+      fail(kName, std::to_string(gridded) + " boids in the grid, expected " + std::to_string(kBoidCount));
+      return false;
+    }
+    return true;
+  });
+  if (!left_world) {
+    fail("open flock", "no boid ever left the world, nothing was tested");
+  }
+}
+
+}  // namespace
+
+/** Boundary policy checks, on single moves and on whole flocks updated for a while */
+int main() {
+  test_reflect_move();
+  test_reflect_flock();
+  test_soft_wall_flock();
+  test_open_flock();
+  if (failures > 0) {
+    std::cerr << failures << " failures\n";
+    return 1;
+  }
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "camera.h"
+
+#include <algorithm>
+
+constexpr float Camera::kZoomStep;
+constexpr float Camera::kMinZoom;
+constexpr float Camera::kPanSpeed;
+
+Camera::Camera(const sf::Vector2u& world_size, const sf::Vector2u& window_size)
+  : world_size_(world_size),
+    window_size_(window_size) {
+  fit_world();
+}
+
+void Camera::handle_event(const sf::Event& event, const sf::RenderWindow& window) {
+  switch (event.type) {
+    case sf::Event::Resized: {
+      window_size_ = sf::Vector2f(event.size.width, event.size.height);
+      set_zoom(zoom_);
+      break;
+    }
+    case sf::Event::MouseWheelScrolled: {
+      /** Keep the world point under the cursor in place while zooming */
+      const sf::Vector2i kPixel(event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+      const sf::Vector2f kBefore = window.mapPixelToCoords(kPixel, view_);
+      set_zoom(event.mouseWheelScroll.delta > 0 ? zoom_ / kZoomStep : zoom_ * kZoomStep);
+      const sf::Vector2f kAfter = window.mapPixelToCoords(kPixel, view_);
+      view_.move(kBefore - kAfter);
+      clamp_center();
+      break;
+    }
+    case sf::Event::MouseButtonPressed: {
+      if (event.mouseButton.button == sf::Mouse::Right) {
+        dragging_ = true;
+        last_drag_position_ = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+      }
+      break;
+    }
+    case sf::Event::MouseButtonReleased: {
+      if (event.mouseButton.button == sf::Mouse::Right) {
+        dragging_ = false;
+      }
+      break;
+    }
+    case sf::Event::MouseMoved: {
+      if (dragging_) {
+        const sf::Vector2i kPosition(event.mouseMove.x, event.mouseMove.y);
+        const sf::Vector2i kDelta = kPosition - last_drag_position_;
+        view_.move(-kDelta.x * zoom_, -kDelta.y * zoom_);
+        clamp_center();
+        last_drag_position_ = kPosition;
+      }
+      break;
+    }
+    case sf::Event::KeyPressed: {
+      if (event.key.code == sf::Keyboard::Home) {
+        fit_world();
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+void Camera::update(float dt) {
+  sf::Vector2f direction;
+  if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) {
+    direction.x -= 1;
+  }
+  if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) {
+    direction.x += 1;
+  }
+  if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) {
+    direction.y -= 1;
+  }
+  if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) {
+    direction.y += 1;
+  }
+
+  if (direction != sf::Vector2f()) {
+    view_.move(direction * (kPanSpeed * zoom_ * dt));
+    clamp_center();
+  }
+}
+
+void Camera::fit_world() {
+  view_.setCenter(world_size_ / 2.0f);
+  set_zoom(std::max(world_size_.x / window_size_.x, world_size_.y / window_size_.y));
+}
+
+const sf::View& Camera::view() const {
+  return view_;
+}
+
+void Camera::set_zoom(float zoom) {
+  /** Don't allow zooming out much further than the whole world */
+  const float kMaxZoom = 2 * std::max(world_size_.x / window_size_.x, world_size_.y / window_size_.y);
+  zoom_ = std::min(std::max(zoom, kMinZoom), std::max(kMaxZoom, kMinZoom));
+  view_.setSize(window_size_ * zoom_);
+}
+
+void Camera::clamp_center() {
+  const sf::Vector2f& kCenter = view_.getCenter();
+  view_.setCenter(std::min(std::max(kCenter.x, 0.0f), world_size_.x),
+                  std::min(std::max(kCenter.y, 0.0f), world_size_.y));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+/**
+ * Pannable and zoomable view over the world.
+ *
+ * Controls:
+ *   mouse wheel        zoom around the cursor
+ *   right mouse drag   pan
+ *   arrow keys         pan
+ *   home               fit whole world
+ */
+class Camera {
+ public:
+  Camera(const sf::Vector2u& world_size, const sf::Vector2u& window_size);
+
+  /**
+   * Handle window event.
+   *
+   * \param event Event.
+   * \param window Window.
+   */
+  void handle_event(const sf::Event& event, const sf::RenderWindow& window);
+
+  /**
+   * Apply continuous (keyboard) panning.
+   *
+   * \param dt Delta time in seconds.
+   */
+  void update(float dt);
+
+  /** Show the whole world */
+  void fit_world();
+
+  const sf::View& view() const;
+ private:
+  void set_zoom(float zoom);
+  void clamp_center();
+
+  static constexpr float kZoomStep = 1.2f;
+  static constexpr float kMinZoom = 1.0f / 16;
+  static constexpr float kPanSpeed = 800;
+
+  sf::Vector2f world_size_;
+  sf::Vector2f window_size_;
+  sf::View view_;
+  float zoom_ = 1;
+  bool dragging_ = false;
+  sf::Vector2i last_drag_position_;
+};
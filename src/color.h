@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+/** RGBA color, keeps the simulation core independent of the graphics library */
+struct Color {
+  Color() = default;
+  Color(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) : r(r), g(g), b(b), a(a) {}
+
+  std::uint8_t r = 0;
+  std::uint8_t g = 0;
+  std::uint8_t b = 0;
+  std::uint8_t a = 255;
+};
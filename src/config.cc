@@ -0,0 +1,248 @@
+#include "config.h"
+
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+using Setter = std::function<void(const std::string&)>;
+using Setters = std::map<std::string, Setter>;
+
+std::string trim(const std::string& value) {
+  const auto kBegin = value.find_first_not_of(" \t\r\n");
+  if (kBegin == std::string::npos) {
+    return "";
+  }
+  const auto kEnd = value.find_last_not_of(" \t\r\n");
+  return value.substr(kBegin, kEnd - kBegin + 1);
+}
+
+Setter make_setter(int& target) {
+  return [&target](const std::string& value) { target = std::stoi(value); };
+}
+
+Setter make_setter(unsigned int& target) {
+  return [&target](const std::string& value) {
+    /** Parsed signed, std::stoul would wrap "-1" around to the largest value */
+    const long long kValue = std::stoll(value);
+    if (kValue < 0 || kValue > std::numeric_limits<unsigned int>::max()) {
+      throw std::out_of_range(value);
+    }
+    target = static_cast<unsigned int>(kValue);
+  };
+}
+
+Setter make_setter(float& target) {
+  return [&target](const std::string& value) { target = std::stof(value); };
+}
+
+Setter make_setter(bool& target) {
+  return [&target](const std::string& value) {
+    if (value != "true" && value != "false" && value != "1" && value != "0") {
+      /** Reported with the key like any other unparsable value */
+      throw std::invalid_argument(value);
+    }
+    target = value == "true" || value == "1";
+  };
+}
+
+Setter make_setter(BoundaryMode& target) {
+  return [&target](const std::string& value) { target = boundary_mode_from_name(value); };
+}
+
+Setter make_setter(std::string& target) {
+  return [&target](const std::string& value) { target = value; };
+}
+
+/** Positions separated by ",", e.g. "100 200, 300 400", empty means none */
+Setter make_setter(Goals& target) {
+  return [&target](const std::string& value) {
+    Goals goals;
+    std::istringstream stream(value);
+    std::string position;
+    while (std::getline(stream, position, ',')) {
+      if (trim(position).empty()) {
+        continue;
+      }
+      std::istringstream position_stream(position);
+      Vector2s goal;
+      std::string rest;
+      if (!(position_stream >> goal.x >> goal.y) || position_stream >> rest) {
+        throw std::invalid_argument(value);
+      }
+      goals.push_back(goal);
+    }
+    target = goals;
+  };
+}
+
+/**
+ * Setter which also rejects values out of range, reported like unparsable ones.
+ *
+ * \param target Config field.
+ * \param valid Function returning true if the parsed value is allowed.
+ */
+template<class T, class Valid>
+Setter make_setter(T& target, Valid valid) {
+  return [&target, valid](const std::string& value) {
+    T parsed = target;
+    make_setter(parsed)(value);
+    if (!valid(parsed)) {
+      throw std::out_of_range(value);
+    }
+    target = parsed;
+  };
+}
+
+/** Map of "<section>.<key>" to the config field it sets, only used while loading */
+Setters make_setters(AppConfig& config) {
+  Boid::Config& boid = config.boid;
+  /** Sizes and radii divide the world into grid cells, NaN fails these too */
+  const auto kPositive = [](auto value) { return value > 0; };
+  const auto kNotNegative = [](auto value) { return value >= 0; };
+  const auto kTopologicalLimit = [](unsigned int value) { return value <= Boid::kMaxTopologicalNeighbours; };
+  return {
+    {"boid.size", make_setter(boid.size, kPositive)},
+    {"boid.move_speed", make_setter(boid.default_move_speed)},
+    {"boid.predator_escape_move_speed", make_setter(boid.predator_escape_move_speed)},
+    {"boid.rotation_speed", make_setter(boid.default_rotation_speed)},
+    {"boid.predator_escape_rotation_speed", make_setter(boid.predator_escape_rotation_speed)},
+    {"boid.separation_distance_factor", make_setter(boid.separation_distance_factor, kPositive)},
+    {"boid.alignment_distance_factor", make_setter(boid.alignment_distance_factor, kPositive)},
+    {"boid.cohesion_distance_factor", make_setter(boid.cohesion_distance_factor, kPositive)},
+    {"boid.cohesion_weight", make_setter(boid.cohesion_weight)},
+    {"boid.alignment_weight", make_setter(boid.alignment_weight)},
+    {"boid.separation_weight", make_setter(boid.separation_weight)},
+    {"boid.steering_falloff", make_setter(boid.steering_falloff)},
+    {"boid.topological_neighbours", make_setter(boid.topological_neighbours, kTopologicalLimit)},
+    {"boid.quantized_neighbours", make_setter(boid.quantized_neighbours)},
+    {"simulation.startup_boid_count", make_setter(config.startup_boid_count)},
+    {"simulation.add_remove_boids_count", make_setter(config.add_remove_boids_count)},
+    {"simulation.threads", make_setter(config.threads)},
+    {"simulation.timestep", make_setter(config.timestep, kNotNegative)},
+    {"simulation.seed", make_setter(config.seed)},
+    {"simulation.morton_sort_interval", make_setter(config.morton_sort_interval)},
+    {"simulation.arena_kb", make_setter(config.arena_kb)},
+    {"metrics.file", make_setter(config.metrics_file)},
+    {"metrics.interval", make_setter(config.metrics_interval)},
+    {"partition.count", make_setter(config.partitions)},
+    {"partition.balance_interval", make_setter(config.balance_interval)},
+    {"partition.balance_threshold", make_setter(config.balance_threshold, kPositive)},
+    {"world.width", make_setter(config.world_width)},
+    {"world.height", make_setter(config.world_height)},
+    {"world.boundary", make_setter(boid.boundary)},
+    {"world.wall_margin", make_setter(boid.wall_margin)},
+    {"world.wall_weight", make_setter(boid.wall_weight)},
+    {"obstacles.file", make_setter(config.obstacles_file)},
+    {"obstacles.cell_size", make_setter(config.obstacle_cell_size, kPositive)},
+    {"obstacles.avoid_distance", make_setter(boid.obstacle_distance)},
+    {"obstacles.weight", make_setter(boid.obstacle_weight)},
+    {"goals.positions", make_setter(config.goals)},
+    {"goals.cell_size", make_setter(config.goal_cell_size, kPositive)},
+    {"goals.weight", make_setter(boid.goal_weight)},
+  };
+}
+
+void set_value(const Setters& setters, const std::string& key, const std::string& value, const std::string& origin) {
+  const auto kSetter = setters.find(key);
+  if (kSetter == setters.end()) {
+    throw std::runtime_error(origin + ": unknown config key \"" + key + "\"");
+  }
+
+  try {
+    kSetter->second(value);
+  } catch (const std::logic_error&) {
+    throw std::runtime_error(origin + ": invalid value \"" + value + "\" for \"" + key + "\"");
+  }
+}
+
+}  // namespace
+
+void load_config_file(const std::string& path, AppConfig& config) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot open config file " + path);
+  }
+
+  const Setters kSetters = make_setters(config);
+  std::string section;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    const std::string kOrigin = path + ":" + std::to_string(line_number);
+    line = trim(line.substr(0, line.find_first_of("#;")));
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line.front() == '[') {
+      if (line.back() != ']') {
+        throw std::runtime_error(kOrigin + ": malformed section header");
+      }
+      section = trim(line.substr(1, line.size() - 2));
+      continue;
+    }
+
+    const auto kSeparator = line.find('=');
+    if (kSeparator == std::string::npos) {
+      throw std::runtime_error(kOrigin + ": expected key = value");
+    }
+
+    const std::string kKey = trim(line.substr(0, kSeparator));
+    const std::string kValue = trim(line.substr(kSeparator + 1));
+    set_value(kSetters, section.empty() ? kKey : section + "." + kKey, kValue, kOrigin);
+  }
+}
+
+Vector2u headless_world_size(const AppConfig& config) {
+  if (config.world_width == 0 || config.world_height == 0) {
+    throw std::runtime_error(std::string("invalid value \"0\" for \"") +
+                             (config.world_width == 0 ? "world.width" : "world.height") +
+                             "\", there is no window size to use instead");
+  }
+  return Vector2u(config.world_width, config.world_height);
+}
+
+AppConfig load_config(int argc, char* argv[], const AppConfig& defaults) {
+  AppConfig config = defaults;
+
+  /** Config file goes first so command line overrides always win */
+  for (int i = 1; i < argc; ++i) {
+    const std::string kArgument = argv[i];
+    if (kArgument == "--config") {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("--config requires a path");
+      }
+      load_config_file(argv[++i], config);
+    } else if (kArgument.compare(0, 9, "--config=") == 0) {
+      load_config_file(kArgument.substr(9), config);
+    }
+  }
+
+  const Setters kSetters = make_setters(config);
+  for (int i = 1; i < argc; ++i) {
+    const std::string kArgument = argv[i];
+    if (kArgument == "--config") {
+      ++i;
+      continue;
+    }
+
+    if (kArgument.compare(0, 9, "--config=") == 0) {
+      continue;
+    }
+
+    const auto kSeparator = kArgument.find('=');
+    if (kArgument.compare(0, 2, "--") != 0 || kSeparator == std::string::npos) {
+      throw std::runtime_error("Unexpected argument \"" + kArgument + "\", expected --<section>.<key>=<value>");
+    }
+
+    set_value(kSetters, kArgument.substr(2, kSeparator - 2), kArgument.substr(kSeparator + 1), "command line");
+  }
+
+  return config;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include "boid.h"
+
+/** Application wide configuration */
+struct AppConfig {
+  /** Boid tuning, copied into the flat block read by Boid::update */
+  Boid::Config boid;
+  unsigned int startup_boid_count = 80;
+  unsigned int add_remove_boids_count = 10;
+  /** World size, independent of the window, 0 means initial window size */
+  unsigned int world_width = 0;
+  unsigned int world_height = 0;
+  /** Number of simulation threads, 0 means hardware concurrency */
+  unsigned int threads = 0;
+  /** Fixed simulation timestep in seconds, 0 means variable (frame time) timestep */
+  float timestep = 0;
+  /** Reorder boids storage along a Z-order curve every this many ticks, 0 means never */
+  unsigned int morton_sort_interval = 30;
+  /** Initial size of the per-thread frame arena for transient per tick data in KiB, grows when a tick overflows it */
+  unsigned int arena_kb = 1024;
+  /** Seed used to place boids, 0 means random seed */
+  unsigned int seed = 0;
+  /** Prometheus text format file the simulation work counters are written to, empty means not gathered */
+  std::string metrics_file;
+  /** Write metrics file every this many ticks */
+  unsigned int metrics_interval = 60;
+  /** Number of worker processes the world is split into by boids_partitioned */
+  unsigned int partitions = 4;
+  /** Move partition edges to balance the load every this many ticks, 0 means never */
+  unsigned int balance_interval = 10;
+  /** Edges are only moved when max / mean partition load is above this factor */
+  float balance_threshold = 1.1f;
+  /** Obstacles file (see load_obstacles), empty means no obstacles */
+  std::string obstacles_file;
+  /** Distance between samples of the baked obstacle field */
+  float obstacle_cell_size = 10;
+  /** Goals boids steer towards, empty means none */
+  Goals goals;
+  /** Cell size of the flow field leading to the goals */
+  float goal_cell_size = 50;
+};
+
+/**
+ * Load config file in INI format, values not present in the file are left untouched.
+ *
+ * Keys are grouped in sections, e.g. "[boid]" followed by "size = 10".
+ *
+ * \param path Path to the config file.
+ * \param config Config to update.
+ */
+void load_config_file(const std::string& path, AppConfig& config);
+
+/**
+ * Build config from defaults, optional config file and command line overrides.
+ *
+ * Supported arguments:
+ *   --config <path>          Load given config file first.
+ *   --<section>.<key>=<value> Override single value, e.g. --boid.size=12.
+ *
+ * \param argc Argument count.
+ * \param argv Arguments.
+ * \param defaults Values used for keys that are neither in the config file nor on the command line.
+ * \return Config.
+ */
+AppConfig load_config(int argc, char* argv[], const AppConfig& defaults = AppConfig());
+
+/**
+ * World size of the config for tools without a window, where a 0 width or height (window size) means nothing.
+ *
+ * \param config Config.
+ * \return World size, throws std::runtime_error if width or height is 0.
+ */
+Vector2u headless_world_size(const AppConfig& config);
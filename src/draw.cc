@@ -1,73 +1,199 @@
 #include "draw.h"
 
-void draw_boid_debug_info(const Boid& boid, sf::RenderWindow& window) {
-  /** Cohesion distance */
-  {
-    const int kBoidCohesionRadius = boid.cohesion_distance();
-    sf::CircleShape circle(kBoidCohesionRadius);
-    circle.setOrigin(kBoidCohesionRadius, kBoidCohesionRadius);
-    circle.move(boid.position());
-    sf::Color color = boid.color();
-    color.a = 32;
-    circle.setFillColor(color);
-    window.draw(circle);
-  }
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "frame_arena.h"
+#include "sfml_conversions.h"
 
-  /** Alignment distance */
-  {
-    const int kBoidAlignmentRadius = boid.alignment_distance();
-    sf::CircleShape circle(kBoidAlignmentRadius);
-    circle.setOrigin(kBoidAlignmentRadius, kBoidAlignmentRadius);
-    circle.move(boid.position());
-    sf::Color color = boid.color();
-    color.a = 48;
-    circle.setFillColor(color);
-    window.draw(circle);
-  }
+namespace {
 
-  /** Separation distance */
-  {
-    const int kBoidSeparationRadius = boid.separation_distance();
-    sf::CircleShape circle(kBoidSeparationRadius);
-    circle.setOrigin(kBoidSeparationRadius, kBoidSeparationRadius);
-    circle.move(boid.position());
-    sf::Color color = boid.color();
-    color.a = 48;
-    circle.setFillColor(color);
-    window.draw(circle);
+/** Vertices built for a single frame, they live in the frame arena of the render thread */
+using Vertices = ArenaVector<sf::Vertex>;
+
+/** On screen boid radius (in pixels) below which boids are drawn as single points */
+constexpr float kPointLodPixelRadius = 2.0f;
+/** On screen boid radius (in pixels) below which boids are drawn as density splats per grid cell */
+constexpr float kDensityLodPixelRadius = 0.5f;
+/** Number of boids in a grid cell at which a density splat becomes fully opaque */
+constexpr unsigned int kDensitySplatSaturationCount = 32;
+/** Triangles of a boid body (hexagon) and direction indicator (quad) */
+constexpr std::size_t kBoidBodyVertexCount = 6 * 3 + 6;
+/** Tessellation of debug radius discs, matches the sf::CircleShape default */
+constexpr std::size_t kDebugCirclePointCount = 30;
+
+sf::FloatRect visible_rect(const sf::View& view, float margin) {
+  const sf::Vector2f& kSize = view.getSize();
+  const sf::Vector2f& kCenter = view.getCenter();
+  return sf::FloatRect(kCenter.x - kSize.x / 2 - margin,
+                       kCenter.y - kSize.y / 2 - margin,
+                       kSize.x + 2 * margin,
+                       kSize.y + 2 * margin);
+}
+
+void append_quad(const sf::Transform& transform,
+                 const sf::FloatRect& rect,
+                 const sf::Color& color,
+                 Vertices& vertices) {
+  const sf::Vector2f kTopLeft = transform.transformPoint(rect.left, rect.top);
+  const sf::Vector2f kTopRight = transform.transformPoint(rect.left + rect.width, rect.top);
+  const sf::Vector2f kBottomRight = transform.transformPoint(rect.left + rect.width, rect.top + rect.height);
+  const sf::Vector2f kBottomLeft = transform.transformPoint(rect.left, rect.top + rect.height);
+  vertices.emplace_back(kTopLeft, color);
+  vertices.emplace_back(kTopRight, color);
+  vertices.emplace_back(kBottomRight, color);
+  vertices.emplace_back(kTopLeft, color);
+  vertices.emplace_back(kBottomRight, color);
+  vertices.emplace_back(kBottomLeft, color);
+}
+
+/** Append boid body (hexagon) and direction indicator as triangles */
+void append_boid_body(const Boid& boid, const BoidAppearance& appearance, Vertices& vertices) {
+  /** Unit hexagon, same point layout as sf::CircleShape with 6 points */
+  static const std::array<sf::Vector2f, 6> kHexagon = [] {
+    std::array<sf::Vector2f, 6> points;
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      const float kAngle = i * 2 * kPi<float> / points.size() - kPi<float> / 2;
+      points[i] = sf::Vector2f(std::cos(kAngle), std::sin(kAngle));
+    }
+    return points;
+  }();
+
+  const float kBoidCircleRadius = boid.size();
+  const sf::Color kColor = to_sfml(appearance.color);
+  sf::Transform transform;
+  transform.translate(to_sfml(boid.position()));
+  transform.rotate(boid.rotation());
+
+  /** Boid body */
+  const sf::Vector2f kCenter = to_sfml(boid.position());
+  for (std::size_t i = 0; i < kHexagon.size(); ++i) {
+    const sf::Vector2f& kFrom = kHexagon[i];
+    const sf::Vector2f& kTo = kHexagon[(i + 1) % kHexagon.size()];
+    vertices.emplace_back(kCenter, kColor);
+    vertices.emplace_back(transform.transformPoint(kFrom * kBoidCircleRadius), kColor);
+    vertices.emplace_back(transform.transformPoint(kTo * kBoidCircleRadius), kColor);
   }
+
+  /** Boid direction indicator */
+  const float kLineWidth = kBoidCircleRadius / 4;
+  append_quad(transform,
+              sf::FloatRect(-kLineWidth / 2, -kBoidCircleRadius * 2, kLineWidth, kBoidCircleRadius * 2),
+              kColor,
+              vertices);
 }
 
-void draw_boids(const Boids& boids, sf::RenderWindow& window, bool debug_boid_drawing) {
-  for (const auto& boid : boids) {
-    if  (debug_boid_drawing) {
-      draw_boid_debug_info(boid, window);
+/** Debug radii of drawn boids, one vertex array (and draw call) per radius type */
+struct BoidDebugBatch {
+  Vertices cohesion;
+  Vertices alignment;
+  Vertices separation;
+};
+
+/** Append filled disc built from the shared pre-tessellated unit circle */
+void append_disc(const sf::Vector2f& center, float radius, const sf::Color& color, Vertices& vertices) {
+  static const std::array<sf::Vector2f, kDebugCirclePointCount> kUnitCircle = [] {
+    std::array<sf::Vector2f, kDebugCirclePointCount> points;
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      const float kAngle = i * 2 * kPi<float> / points.size();
+      points[i] = sf::Vector2f(std::cos(kAngle), std::sin(kAngle));
     }
+    return points;
+  }();
 
-    {
-      const int kBoidCircleRadius = boid.size();
-      /** Boid body */
-      {
-        sf::CircleShape circle(kBoidCircleRadius, 6);
-        circle.setOrigin(kBoidCircleRadius, kBoidCircleRadius);
-        circle.rotate(boid.rotation());
-        circle.move(boid.position());
-        circle.setFillColor(boid.color());
-        window.draw(circle);
-      }
-
-      /** Boid direction indicator */
-      {
-        const int kLineWidth = kBoidCircleRadius / 4;
-        sf::RectangleShape line(sf::Vector2f(kLineWidth, kBoidCircleRadius * 2));
-        line.setOrigin(kLineWidth / 2, kBoidCircleRadius * 2);
-        line.rotate(boid.rotation());
-        line.move(boid.position());
-        line.setFillColor(boid.color());
-        window.draw(line);
-      }
+  for (std::size_t i = 0; i < kUnitCircle.size(); ++i) {
+    vertices.emplace_back(center, color);
+    vertices.emplace_back(center + kUnitCircle[i] * radius, color);
+    vertices.emplace_back(center + kUnitCircle[(i + 1) % kUnitCircle.size()] * radius, color);
+  }
+}
+
+void append_boid_debug_info(const Boid& boid, const BoidAppearance& appearance, BoidDebugBatch& batch) {
+  const sf::Vector2f kPosition = to_sfml(boid.position());
+  sf::Color color = to_sfml(appearance.color);
+  color.a = 32;
+  append_disc(kPosition, boid.cohesion_distance(), color, batch.cohesion);
+  color.a = 48;
+  append_disc(kPosition, boid.alignment_distance(), color, batch.alignment);
+  append_disc(kPosition, boid.separation_distance(), color, batch.separation);
+}
+
+void draw_boid_density(const SpatialGrid& grid, const sf::FloatRect& rect, sf::RenderWindow& window) {
+  Vertices vertices;
+  const Vector2s kMin(rect.left, rect.top);
+  const Vector2s kMax(rect.left + rect.width, rect.top + rect.height);
+  grid.for_each_cell_in_rect(kMin, kMax, [&](const Vector2s& cell_min, Scalar cell_size, unsigned int count) {
+    if (count == 0) {
+      return;
     }
+
+    const sf::Uint8 kAlpha = 255 * std::min(count, kDensitySplatSaturationCount) / kDensitySplatSaturationCount;
+    append_quad(sf::Transform::Identity,
+                sf::FloatRect(cell_min.x, cell_min.y, cell_size, cell_size),
+                sf::Color(255, 255, 255, kAlpha),
+                vertices);
+  });
+  window.draw(vertices.data(), vertices.size(), sf::Triangles);
+}
+
+}  // namespace
+
+void draw_boids(const Boids& boids,
+                const BoidAppearances& appearances,
+                const SpatialGrid& grid,
+                sf::RenderWindow& window,
+                DebugDrawing debug_drawing) {
+  const sf::View& kView = window.getView();
+  const float kBoidPixelRadius = Boid::config().size * window.getSize().x / kView.getSize().x;
+
+  /** Boids smaller than a pixel, draw cost depends only on the number of visible cells */
+  if (kBoidPixelRadius < kDensityLodPixelRadius) {
+    draw_boid_density(grid, visible_rect(kView, 0), window);
+    return;
   }
+
+  /** Boids are stored by their center, grow the view so partially visible ones are still drawn */
+  const bool kFullDetail = kBoidPixelRadius >= kPointLodPixelRadius;
+  const float kMargin = 2 * Boid::config().size +
+    (debug_drawing != DebugDrawing::kNone ? Boid::config().size * Boid::config().cohesion_distance_factor : 0);
+  const sf::FloatRect kVisibleRect = visible_rect(kView, kMargin);
+
+  const Vector2s kMin(kVisibleRect.left, kVisibleRect.top);
+  const Vector2s kMax(kVisibleRect.left + kVisibleRect.width, kVisibleRect.top + kVisibleRect.height);
+
+  /** Boids in the visible cells are an upper bound of the drawn ones, so the arena never regrows for them */
+  std::size_t candidate_count = 0;
+  grid.for_each_cell_in_rect(kMin, kMax, [&](const Vector2s&, Scalar, unsigned int count) {
+    candidate_count += count;
+  });
+
+  /** Frame arena storage, released in one go when the next frame starts */
+  Vertices vertices;
+  vertices.reserve(candidate_count * (kFullDetail ? kBoidBodyVertexCount : 1));
+  BoidDebugBatch debug_batch;
+  grid.for_each_in_rect(kMin, kMax, [&](unsigned int index) {
+    const Boid& boid = boids[index];
+    if (!kVisibleRect.contains(to_sfml(boid.position()))) {
+      return;
+    }
+
+    const BoidAppearance& appearance = appearances[index];
+    if (debug_drawing == DebugDrawing::kAll ||
+        (debug_drawing == DebugDrawing::kSelected && appearance.debug_selected)) {
+      append_boid_debug_info(boid, appearance, debug_batch);
+    }
+
+    if (kFullDetail) {
+      append_boid_body(boid, appearance, vertices);
+    } else {
+      vertices.emplace_back(to_sfml(boid.position()), to_sfml(appearance.color));
+    }
+  });
+
+  window.draw(debug_batch.cohesion.data(), debug_batch.cohesion.size(), sf::Triangles);
+  window.draw(debug_batch.alignment.data(), debug_batch.alignment.size(), sf::Triangles);
+  window.draw(debug_batch.separation.data(), debug_batch.separation.size(), sf::Triangles);
+  window.draw(vertices.data(), vertices.size(), kFullDetail ? sf::Triangles : sf::Points);
 }
 
 void draw_predators(const Predators& predators, sf::RenderWindow& window) {
@@ -75,8 +201,35 @@ void draw_predators(const Predators& predators, sf::RenderWindow& window) {
     const int kPredatorRadius = predator.size;
     sf::CircleShape circle(kPredatorRadius);
     circle.setOrigin(kPredatorRadius, kPredatorRadius);
-    circle.move(predator.position);
+    circle.move(to_sfml(predator.position));
     circle.setFillColor(sf::Color::Red);
     window.draw(circle);
   }
 }
+
+void draw_obstacles(const Obstacles& obstacles, sf::RenderWindow& window) {
+  const sf::Color kColor(90, 90, 110);
+  Vertices vertices;
+  for (const Obstacle& kObstacle : obstacles) {
+    if (kObstacle.shape == Obstacle::Shape::kCircle) {
+      append_disc(to_sfml(kObstacle.center), kObstacle.radius, kColor, vertices);
+    } else {
+      const Vector2s kTopLeft = kObstacle.center - kObstacle.half_size;
+      append_quad(sf::Transform::Identity,
+                  sf::FloatRect(kTopLeft.x, kTopLeft.y, 2 * kObstacle.half_size.x, 2 * kObstacle.half_size.y),
+                  kColor,
+                  vertices);
+    }
+  }
+  window.draw(vertices.data(), vertices.size(), sf::Triangles);
+}
+
+void draw_goals(const Goals& goals, sf::RenderWindow& window) {
+  constexpr float kGoalRadius = 12;
+  const sf::Color kColor(60, 200, 90);
+  Vertices vertices;
+  for (const Vector2s& kGoal : goals) {
+    append_disc(to_sfml(kGoal), kGoalRadius, kColor, vertices);
+  }
+  window.draw(vertices.data(), vertices.size(), sf::Triangles);
+}
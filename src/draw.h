@@ -1,23 +1,31 @@
 #pragma once
 
+#include <SFML/Graphics.hpp>
 #include "boid.h"
+#include "obstacles.h"
+#include "spatial_grid.h"
 
-/**
- * Draw boid debug info.
- *
- * \param boid Boid.
- * \param window Window.
- */
-void draw_boid_debug_info(const Boid& boid, sf::RenderWindow& window);
+/** Which boids get their cohesion/alignment/separation radii drawn */
+enum class DebugDrawing {
+  kNone,
+  kAll,
+  kSelected,
+};
 
 /**
- * Draw boids.
+ * Draw boids visible through the current window view.
  *
  * \param boids Boids.
+ * \param appearances Appearances of boids, same indices.
+ * \param grid Spatial grid built from boids, used to skip boids outside of the view.
  * \param window Window.
- * \param debug_boid_drawing If debug info should be drawn.
+ * \param debug_drawing Boids which debug info should be drawn for.
  */
-void draw_boids(const Boids& boids, sf::RenderWindow& window, bool debug_boid_drawing);
+void draw_boids(const Boids& boids,
+                const BoidAppearances& appearances,
+                const SpatialGrid& grid,
+                sf::RenderWindow& window,
+                DebugDrawing debug_drawing);
 
 /**
  * Draw predators.
@@ -27,3 +35,18 @@ void draw_boids(const Boids& boids, sf::RenderWindow& window, bool debug_boid_dr
  */
 void draw_predators(const Predators& predators, sf::RenderWindow& window);
 
+/**
+ * Draw obstacles.
+ *
+ * \param obstacles Obstacles.
+ * \param window Window.
+ */
+void draw_obstacles(const Obstacles& obstacles, sf::RenderWindow& window);
+
+/**
+ * Draw goals.
+ *
+ * \param goals Goals.
+ * \param window Window.
+ */
+void draw_goals(const Goals& goals, sf::RenderWindow& window);
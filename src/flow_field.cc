@@ -0,0 +1,190 @@
+#include "flow_field.h"
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include "obstacles.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+const Scalar FlowField::kUnreachable = std::numeric_limits<Scalar>::max();
+
+namespace {
+
+/** Neighbour cell offsets, orthogonal ones first */
+constexpr int kNeighbourCount = 8;
+constexpr int kNeighbourColumns[kNeighbourCount] = {1, -1, 0, 0, 1, 1, -1, -1};
+constexpr int kNeighbourRows[kNeighbourCount] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+}  // namespace
+
+void FlowField::reset(const Vector2u& world_size,
+                      Scalar cell_size,
+                      bool wraps,
+                      const ObstacleField* obstacles,
+                      ThreadPool& thread_pool) {
+  world_size_ = Vector2s(world_size.x, world_size.y);
+  cell_size_ = cell_size;
+  columns_ = std::max(1, static_cast<int>(std::ceil(world_size_.x / cell_size_)));
+  rows_ = std::max(1, static_cast<int>(std::ceil(world_size_.y / cell_size_)));
+  wraps_ = wraps;
+  goals_.clear();
+
+  const std::size_t kCellCount = static_cast<std::size_t>(columns_) * rows_;
+  blocked_.assign(kCellCount, 0);
+  costs_.assign(kCellCount, kUnreachable);
+  directions_.assign(kCellCount, Vector2s());
+  /** Every cell is queued at most once per neighbour, so recomputing never grows the queue past this */
+  queue_.clear();
+  queue_.reserve(kCellCount * kNeighbourCount);
+
+  if (!obstacles || obstacles->empty()) {
+    return;
+  }
+  thread_pool.parallel_for(rows_, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t row = begin; row < end; ++row) {
+      for (int column = 0; column < columns_; ++column) {
+        const Vector2s kCenter((column + Scalar(0.5)) * cell_size_, (row + Scalar(0.5)) * cell_size_);
+        blocked_[row * columns_ + column] = obstacles->sample(kCenter).distance < 0;
+      }
+    }
+  });
+}
+
+void FlowField::update(const Goals& goals, ThreadPool& thread_pool) {
+  if (goals == goals_) {
+    return;
+  }
+
+  goals_ = goals;
+  if (goals_.empty() || directions_.empty()) {
+    return;
+  }
+  compute_costs();
+  compute_directions(thread_pool);
+}
+
+bool FlowField::empty() const {
+  return goals_.empty() || directions_.empty();
+}
+
+const Goals& FlowField::goals() const {
+  return goals_;
+}
+
+void FlowField::compute_costs() {
+  using Entry = std::pair<Scalar, int>;
+  const auto kCheaper = std::greater<Entry>();
+  std::fill(costs_.begin(), costs_.end(), kUnreachable);
+  queue_.clear();
+  for (const Vector2s& kGoal : goals_) {
+    const int kColumn = std::min(std::max(static_cast<int>(kGoal.x / cell_size_), 0), columns_ - 1);
+    const int kRow = std::min(std::max(static_cast<int>(kGoal.y / cell_size_), 0), rows_ - 1);
+    const int kCell = kRow * columns_ + kColumn;
+    if (!blocked_[kCell] && costs_[kCell] != 0) {
+      costs_[kCell] = 0;
+      queue_.emplace_back(Scalar(0), kCell);
+    }
+  }
+  std::make_heap(queue_.begin(), queue_.end(), kCheaper);
+
+  const Scalar kDiagonalCost = std::sqrt(Scalar(2));
+  while (!queue_.empty()) {
+    std::pop_heap(queue_.begin(), queue_.end(), kCheaper);
+    const Entry kEntry = queue_.back();
+    queue_.pop_back();
+    /** Stale entry, the cell was reached cheaper after this one was queued */
+    if (kEntry.first > costs_[kEntry.second]) {
+      continue;
+    }
+
+    const int kColumn = kEntry.second % columns_;
+    const int kRow = kEntry.second / columns_;
+    bool open[kNeighbourCount] = {};
+    for (int i = 0; i < kNeighbourCount; ++i) {
+      int column = kColumn + kNeighbourColumns[i];
+      int row = kRow + kNeighbourRows[i];
+      if (wraps_) {
+        column = (column + columns_) % columns_;
+        row = (row + rows_) % rows_;
+      } else if (column < 0 || column >= columns_ || row < 0 || row >= rows_) {
+        continue;
+      }
+      const int kCell = row * columns_ + column;
+      if (blocked_[kCell]) {
+        continue;
+      }
+      open[i] = true;
+      /** Diagonal steps only when both orthogonal cells next to them are open, paths don't cut obstacle corners */
+      if (i >= 4 && !(open[kNeighbourColumns[i] > 0 ? 0 : 1] && open[kNeighbourRows[i] > 0 ? 2 : 3])) {
+        continue;
+      }
+      const Scalar kCost = kEntry.first + (i < 4 ? Scalar(1) : kDiagonalCost);
+      if (kCost < costs_[kCell]) {
+        costs_[kCell] = kCost;
+        queue_.emplace_back(kCost, kCell);
+        std::push_heap(queue_.begin(), queue_.end(), kCheaper);
+      }
+    }
+  }
+}
+
+void FlowField::compute_directions(ThreadPool& thread_pool) {
+  thread_pool.parallel_for(rows_, [&](std::size_t begin, std::size_t end) {
+    for (int row = static_cast<int>(begin); row < static_cast<int>(end); ++row) {
+      for (int column = 0; column < columns_; ++column) {
+        const int kCell = row * columns_ + column;
+        Vector2s& direction = directions_[kCell];
+        direction = Vector2s();
+        if (costs_[kCell] == kUnreachable) {
+          continue;
+        }
+
+        if (costs_[kCell] == 0) {
+          /** Goal cell, straight to the closest goal in it */
+          const Vector2s kCenter((column + Scalar(0.5)) * cell_size_, (row + Scalar(0.5)) * cell_size_);
+          Vector2s closest;
+          Scalar closest_distance = kUnreachable;
+          for (const Vector2s& kGoal : goals_) {
+            const Vector2s kOffset = wraps_ ? toroidal_offset(kGoal - kCenter, world_size_) : kGoal - kCenter;
+            const Scalar kDistance = length(kOffset);
+            if (kDistance < closest_distance) {
+              closest = kOffset;
+              closest_distance = kDistance;
+            }
+          }
+          direction = normalized(closest);
+          continue;
+        }
+
+        /** Towards the cheapest neighbour, the same steps the costs were spread by */
+        Scalar cheapest = costs_[kCell];
+        bool open[kNeighbourCount] = {};
+        for (int i = 0; i < kNeighbourCount; ++i) {
+          int neighbour_column = column + kNeighbourColumns[i];
+          int neighbour_row = row + kNeighbourRows[i];
+          if (wraps_) {
+            neighbour_column = (neighbour_column + columns_) % columns_;
+            neighbour_row = (neighbour_row + rows_) % rows_;
+          } else if (neighbour_column < 0 || neighbour_column >= columns_ || neighbour_row < 0 ||
+                     neighbour_row >= rows_) {
+            continue;
+          }
+          const int kNeighbour = neighbour_row * columns_ + neighbour_column;
+          if (blocked_[kNeighbour]) {
+            continue;
+          }
+          open[i] = true;
+          if (i >= 4 && !(open[kNeighbourColumns[i] > 0 ? 0 : 1] && open[kNeighbourRows[i] > 0 ? 2 : 3])) {
+            continue;
+          }
+          if (costs_[kNeighbour] < cheapest) {
+            cheapest = costs_[kNeighbour];
+            direction = Vector2s(kNeighbourColumns[i], kNeighbourRows[i]);
+          }
+        }
+        direction = normalized(direction);
+      }
+    }
+  });
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "scalar.h"
+
+class ObstacleField;
+class ThreadPool;
+
+using Goals = std::vector<Vector2s>;
+
+/**
+ * Steering directions towards the closest goal, one per grid cell, so boids find their way around obstacles without
+ * any per boid path search.
+ *
+ * Computed in two passes when the goals change: travel costs from every cell to the closest goal (Dijkstra from all
+ * goals at once, 8 neighbours, cells inside obstacles are blocked) and then the direction of the cheapest neighbour of
+ * every cell, split across the thread pool by rows. A lookup is a bilinear interpolation of the four surrounding
+ * directions.
+ */
+class FlowField {
+ public:
+  /**
+   * Lay the field out over the world and mark cells blocked by obstacles, drops the goals.
+   *
+   * \param world_size World size, positions outside of it take the direction at the closest edge unless wrapping.
+   * \param cell_size Cell size, passages narrower than this may be closed.
+   * \param wraps True if paths may leave the world on one side and come back on the opposite one, lookups then
+   *              interpolate across the seam too.
+   * \param obstacles Obstacles, nullptr means none.
+   * \param thread_pool Thread pool the cells are split across.
+   */
+  void reset(const Vector2u& world_size,
+             Scalar cell_size,
+             bool wraps,
+             const ObstacleField* obstacles,
+             ThreadPool& thread_pool);
+
+  /**
+   * Recompute directions if goals differ from the ones of the previous call, otherwise does nothing. Only allocates
+   * when the number of goals grows.
+   *
+   * \param goals Goals in world coordinates.
+   * \param thread_pool Thread pool the direction pass is split across.
+   */
+  void update(const Goals& goals, ThreadPool& thread_pool);
+
+  /** True if there are no goals (or the field was never laid out), sample must not be called then */
+  bool empty() const;
+
+  /**
+   * Direction towards the closest goal at given position.
+   *
+   * \param position Position in world coordinates.
+   * \return Direction, unit length away from goals and obstacles, shorter near them, zero where no goal is reachable.
+   */
+  Vector2s sample(const Vector2s& position) const {
+    /** Directions are stored at cell centers */
+    const Scalar kX = position.x / cell_size_ - Scalar(0.5);
+    const Scalar kY = position.y / cell_size_ - Scalar(0.5);
+    int column;
+    int row;
+    Scalar tx;
+    Scalar ty;
+    /** Offsets from a cell to the next one to the right and below, single column or row worlds read the same cell */
+    int next_column;
+    int next_row;
+    if (wraps_) {
+      /** Across the seam the lookup interpolates with the cells on the opposite side, like the paths continue */
+      const Scalar kColumnFloor = std::floor(kX);
+      const Scalar kRowFloor = std::floor(kY);
+      column = (static_cast<int>(kColumnFloor) % columns_ + columns_) % columns_;
+      row = (static_cast<int>(kRowFloor) % rows_ + rows_) % rows_;
+      tx = kX - kColumnFloor;
+      ty = kY - kRowFloor;
+      next_column = column + 1 < columns_ ? 1 : 1 - columns_;
+      next_row = row + 1 < rows_ ? columns_ : (1 - rows_) * columns_;
+    } else {
+      const Scalar kClampedX = std::min(std::max(kX, Scalar(0)), Scalar(columns_ - 1));
+      const Scalar kClampedY = std::min(std::max(kY, Scalar(0)), Scalar(rows_ - 1));
+      column = std::min(static_cast<int>(kClampedX), std::max(columns_ - 2, 0));
+      row = std::min(static_cast<int>(kClampedY), std::max(rows_ - 2, 0));
+      tx = kClampedX - column;
+      ty = kClampedY - row;
+      next_column = columns_ > 1 ? 1 : 0;
+      next_row = rows_ > 1 ? columns_ : 0;
+    }
+
+    const Vector2s* const kTop = &directions_[row * columns_ + column];
+    const Vector2s* const kBottom = kTop + next_row;
+    const Vector2s kTopValue = kTop[0] + (kTop[next_column] - kTop[0]) * tx;
+    const Vector2s kBottomValue = kBottom[0] + (kBottom[next_column] - kBottom[0]) * tx;
+    return kTopValue + (kBottomValue - kTopValue) * ty;
+  }
+
+  const Goals& goals() const;
+ private:
+  /** Cost of a cell no goal can be reached from */
+  static const Scalar kUnreachable;
+
+  void compute_costs();
+  void compute_directions(ThreadPool& thread_pool);
+
+  Vector2s world_size_;
+  Scalar cell_size_ = 1;
+  int columns_ = 0;
+  int rows_ = 0;
+  bool wraps_ = false;
+  Goals goals_;
+  /** Per cell, row by row */
+  std::vector<unsigned char> blocked_;
+  std::vector<Scalar> costs_;
+  std::vector<Vector2s> directions_;
+  /** Dijkstra queue of (cost, cell), kept between updates so recomputing doesn't allocate */
+  std::vector<std::pair<Scalar, int>> queue_;
+};
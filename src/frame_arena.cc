@@ -0,0 +1,68 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+constexpr std::size_t FrameArena::kDefaultCapacity;
+
+namespace {
+
+std::atomic<std::size_t> g_initial_capacity(FrameArena::kDefaultCapacity);
+
+unsigned char* align_up(unsigned char* pointer, std::size_t alignment) {
+  const auto kAddress = reinterpret_cast<std::uintptr_t>(pointer);
+  return pointer + ((alignment - kAddress % alignment) % alignment);
+}
+
+}  // namespace
+
+FrameArena::FrameArena(std::size_t capacity)
+  : buffer_(new unsigned char[capacity]),
+    capacity_(capacity) {}
+
+void* FrameArena::allocate(std::size_t size, std::size_t alignment) {
+  used_ += size;
+  peak_ = std::max(peak_, used_);
+
+  unsigned char* const kStart = align_up(buffer_.get() + offset_, alignment);
+  if (kStart + size <= buffer_.get() + capacity_) {
+    offset_ = kStart + size - buffer_.get();
+    return kStart;
+  }
+
+  overflow_.emplace_back(new unsigned char[size + alignment]);
+  return align_up(overflow_.back().get(), alignment);
+}
+
+void FrameArena::reset() {
+  if (!overflow_.empty()) {
+    overflow_.clear();
+    /** Peak plus slack for alignment padding, doubled so slowly growing workloads don't reallocate every tick */
+    capacity_ = std::max(capacity_ * 2, peak_ + peak_ / 8);
+    buffer_.reset(new unsigned char[capacity_]);
+  }
+  offset_ = 0;
+  used_ = 0;
+}
+
+std::size_t FrameArena::capacity() const {
+  return capacity_;
+}
+
+std::size_t FrameArena::used() const {
+  return used_;
+}
+
+std::size_t FrameArena::peak() const {
+  return peak_;
+}
+
+FrameArena& FrameArena::for_current_thread() {
+  static thread_local FrameArena arena(g_initial_capacity.load(std::memory_order_relaxed));
+  return arena;
+}
+
+void FrameArena::set_initial_capacity(std::size_t capacity) {
+  g_initial_capacity.store(capacity, std::memory_order_relaxed);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Bump allocator for data which lives for a single tick (or frame), one per thread.
+ *
+ * Allocation is a pointer bump, deallocation does nothing and reset() releases everything at once. When a tick
+ * needs more than the capacity, the rest comes from overflow blocks on the heap and the next reset() grows the
+ * arena to fit, so after the first few ticks the arena never touches the heap.
+ *
+ * Anything allocated from an arena must be gone before the thread owning it calls reset().
+ */
+class FrameArena {
+ public:
+  static constexpr std::size_t kDefaultCapacity = 1 << 20;
+
+  explicit FrameArena(std::size_t capacity);
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  /**
+   * Allocate memory valid until the next reset.
+   *
+   * \param size Size in bytes.
+   * \param alignment Alignment, power of two.
+   * \return Memory.
+   */
+  void* allocate(std::size_t size, std::size_t alignment);
+
+  /** Release everything, grow the arena if the last period overflowed */
+  void reset();
+
+  std::size_t capacity() const;
+  /** Bytes allocated since the last reset */
+  std::size_t used() const;
+  /** Largest number of bytes allocated between two resets, use it to size the arena */
+  std::size_t peak() const;
+
+  /** Arena of the calling thread, created with the initial capacity on first use */
+  static FrameArena& for_current_thread();
+
+  /**
+   * Set capacity of arenas created from now on.
+   *
+   * \param capacity Capacity in bytes.
+   */
+  static void set_initial_capacity(std::size_t capacity);
+ private:
+  std::unique_ptr<unsigned char[]> buffer_;
+  std::size_t capacity_ = 0;
+  std::size_t offset_ = 0;
+  /** Heap blocks handed out after the buffer filled up, freed on reset */
+  std::vector<std::unique_ptr<unsigned char[]>> overflow_;
+  std::size_t used_ = 0;
+  std::size_t peak_ = 0;
+};
+
+/** STL allocator adapter, lets standard containers live in a FrameArena */
+template<class T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  /** \param arena Arena, the one of the calling thread by default */
+  explicit ArenaAllocator(FrameArena& arena = FrameArena::for_current_thread()) : arena_(&arena) {}
+
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(std::size_t count) {
+    return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+  }
+
+  /** Memory goes back all at once on reset */
+  void deallocate(T*, std::size_t) {}
+
+  FrameArena* arena() const {
+    return arena_;
+  }
+ private:
+  FrameArena* arena_;
+};
+
+template<class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+/** Vector living in a frame arena, reserve up front when the size is known, growth leaves the old storage behind */
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
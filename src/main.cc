@@ -1,86 +1,68 @@
-#include <array>
-#include <random>
 #include <SFML/Graphics.hpp>
 
+#include "allocation_tracker.h"
 #include "arial_font.h"
-#include "predator.h"
-#include "boid.h"
+#include "camera.h"
+#include "config.h"
 #include "draw.h"
+#include "frame_arena.h"
+#include "rate_counter.h"
+#include "sfml_conversions.h"
+#include "simulation.h"
 
-constexpr unsigned int kAddRemoveBoidsCount = 10;
-constexpr unsigned int kStartupBoidCount = 80;
-
-Boid randomize_boids(const sf::Window& window) {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::uniform_int_distribution<> random_rotation(0, 359);
-  static std::uniform_int_distribution<> random_color_channel_value(50, 255);
-  const sf::Vector2u& window_size = window.getSize();
-  std::uniform_int_distribution<> random_pos_x(0, window_size.x);
-  std::uniform_int_distribution<> random_pos_y(0, window_size.y);
-
-  return Boid(sf::Vector2f(random_pos_x(gen), random_pos_y(gen)),
-              random_rotation(gen),
-              sf::Color(random_color_channel_value(gen),
-                        random_color_channel_value(gen),
-                        random_color_channel_value(gen)));
-}
-
-Boids randomize_boids(Boids& boids, const sf::Window& window) {
-  for (auto& boid : boids) {
-    boid = randomize_boids(window);
-  }
-
-  return boids;
-}
-
-void add_boids(Boids& boids, unsigned int count, const sf::Window& window) {
-  boids.reserve(boids.size() + count);
-  for (unsigned int i = 0; i < count; ++i) {
-    boids.push_back(randomize_boids(window));
-  }
-}
-
-void remove_boids(Boids& boids, unsigned int count) {
-  if (boids.size() > 1) {
-    const Boids::size_type kNumberOfBoidsToRemove = std::min(boids.size(), static_cast<Boids::size_type>(count));
-
-    Boids(boids.begin() + kNumberOfBoidsToRemove, boids.end()).swap(boids);
-  }
-}
-
-void update_boids(Boids& boids, const Predators& predators, const sf::Time& dt, const sf::Window& window) {
+Vector2u world_size(const AppConfig& config, const sf::Window& window) {
   const sf::Vector2u& kWindowSize = window.getSize();
-  const float kDeltaTimeSeconds = dt.asSeconds();
-  for (auto& boid : boids) {
-    boid.update(boids, predators, kDeltaTimeSeconds, kWindowSize);
-  }
+  return Vector2u(config.world_width ? config.world_width : kWindowSize.x,
+                  config.world_height ? config.world_height : kWindowSize.y);
 }
 
 int main(int argc, char* argv[]) {
+  const AppConfig kConfig = load_config(argc, argv);
+  Boid::set_config(kConfig.boid);
+
   sf::Font font;
-  if (!font.loadFromMemory(kArialFont.data(), kArialFont.size())) {
+  if (!font.loadFromMemory(kArialFont, kArialFontSize)) {
     throw std::runtime_error("Cannot load font");
   }
 
   sf::RenderWindow window(sf::VideoMode(1024, 768), "Boids");
   window.setMouseCursorVisible(false);
+  /** Simulation runs on its own thread, waiting for vsync here doesn't slow it down */
+  window.setVerticalSyncEnabled(true);
+
+  /** World size is fixed at startup, the camera decides which part of it is shown */
+  const Vector2u kWorldSize = world_size(kConfig, window);
+  Camera camera(to_sfml(kWorldSize), window.getSize());
+  sf::View hud_view(sf::FloatRect(0, 0, window.getSize().x, window.getSize().y));
+
+  /** Before the simulation thread starts, so its arena gets the configured size too */
+  FrameArena::set_initial_capacity(kConfig.arena_kb * std::size_t(1024));
+  Simulation simulation(kConfig, kWorldSize);
+  simulation.start();
 
   sf::Clock clock;
-  Boids boids(kStartupBoidCount);
-  randomize_boids(boids, window);
-  Predators predators;
+  RateCounter frame_rate;
 
   sf::Text help_text(
       std::string("Help:\n") +
         "Move the mouse to scare the boids\n" +
         "r : randomize boids\n" +
-        "+ : add " + std::to_string(kAddRemoveBoidsCount) + " boids\n" +
-        "- : remove " + std::to_string(kAddRemoveBoidsCount) + " boids\n" +
-        "d : on/off debug boid drawing\n",
+        "+ : add " + std::to_string(kConfig.add_remove_boids_count) + " boids\n" +
+        "- : remove " + std::to_string(kConfig.add_remove_boids_count) + " boids\n" +
+        "d : debug boid drawing off/all/selected\n" +
+        "left click : select boid for debug drawing\n" +
+        "g : add / remove goal at the mouse\n" +
+        "mouse wheel : zoom\n" +
+        "right mouse drag / arrows : pan\n" +
+        "home : show whole world\n",
       font);
 
-  bool debug_boid_drawing = false;
+  sf::Text stats_text("", font, 20);
+  stats_text.setPosition(0, 400);
+
+  DebugDrawing debug_drawing = DebugDrawing::kNone;
+  AllocationCounts previous_draw_allocations;
+  FrameArena& frame_arena = FrameArena::for_current_thread();
 
   while (window.isOpen()) {
     sf::Event event;
@@ -90,25 +72,54 @@ int main(int argc, char* argv[]) {
       }
 
       if (event.type == sf::Event::Resized) {
-        window.setView(sf::View(sf::FloatRect(0, 0, event.size.width, event.size.height)));
+        hud_view.reset(sf::FloatRect(0, 0, event.size.width, event.size.height));
+      }
+
+      camera.handle_event(event, window);
+
+      if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+        SimulationCommand command;
+        command.type = SimulationCommand::Type::kToggleSelection;
+        command.position = from_sfml(window.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y),
+                                                             camera.view()));
+        simulation.push_command(command);
       }
 
       if (event.type == sf::Event::KeyPressed) {
         switch(event.key.code) {
           case sf::Keyboard::R: {
-            randomize_boids(boids, window);
+            SimulationCommand command;
+            command.type = SimulationCommand::Type::kRandomize;
+            simulation.push_command(command);
             break;
           }
           case sf::Keyboard::Add: {
-            add_boids(boids, kAddRemoveBoidsCount, window);
+            SimulationCommand command;
+            command.type = SimulationCommand::Type::kAddBoids;
+            simulation.push_command(command);
             break;
           }
           case sf::Keyboard::Subtract: {
-            remove_boids(boids, kAddRemoveBoidsCount);
+            SimulationCommand command;
+            command.type = SimulationCommand::Type::kRemoveBoids;
+            simulation.push_command(command);
+            break;
+          }
+          case sf::Keyboard::G: {
+            SimulationCommand command;
+            command.type = SimulationCommand::Type::kToggleGoal;
+            command.position = from_sfml(window.mapPixelToCoords(sf::Mouse::getPosition(window), camera.view()));
+            simulation.push_command(command);
             break;
           }
           case sf::Keyboard::D: {
-            debug_boid_drawing = !debug_boid_drawing;
+            if (debug_drawing == DebugDrawing::kNone) {
+              debug_drawing = DebugDrawing::kAll;
+            } else if (debug_drawing == DebugDrawing::kAll) {
+              debug_drawing = DebugDrawing::kSelected;
+            } else {
+              debug_drawing = DebugDrawing::kNone;
+            }
             break;
           }
           default: {
@@ -118,27 +129,53 @@ int main(int argc, char* argv[]) {
       }
     }
 
+    /** Event handling above is input, everything from here on is attributed to drawing */
+    AllocationScope allocation_scope(AllocationPhase::kDraw);
+    /** Vertices of the previous frame were drawn already */
+    frame_arena.reset();
     window.clear(sf::Color::Black);
 
     const sf::Time& kDt = clock.getElapsedTime();
     clock.restart();
 
-    Predators final_predators = predators;
-    {
-      Predator mouse_predator;
-      const sf::Vector2i& mouse_position = sf::Mouse::getPosition(window);
-      mouse_predator.position.x = mouse_position.x;
-      mouse_predator.position.y = mouse_position.y;
-      final_predators.push_back(mouse_predator);
+    camera.update(kDt.asSeconds());
+
+    simulation.set_predator_position(from_sfml(window.mapPixelToCoords(sf::Mouse::getPosition(window), camera.view())));
+
+    const FrameSnapshot& kFrame = simulation.latest_frame();
+
+    window.setView(camera.view());
+    draw_obstacles(simulation.obstacles(), window);
+    draw_goals(kFrame.goals, window);
+    draw_boids(kFrame.boids, kFrame.appearances, kFrame.grid, window, debug_drawing);
+    draw_predators(kFrame.predators, window);
+
+    frame_rate.tick();
+    std::string stats = "boids: " + std::to_string(kFrame.boids.size()) + "\n" +
+                        "simulation: " + std::to_string(static_cast<int>(kFrame.tick_rate)) + " ticks/s\n" +
+                        "grid reinsertions: " + std::to_string(kFrame.grid_reinsertions) + " per tick\n" +
+                        "render: " + std::to_string(static_cast<int>(frame_rate.rate())) + " fps\n" +
+                        "arena peak: " + std::to_string(kFrame.arena_peak_bytes / 1024) + " KiB per tick, " +
+                        std::to_string(frame_arena.peak() / 1024) + " KiB per frame\n";
+    if (allocation_tracking_enabled()) {
+      /** Measured between the same point of consecutive frames */
+      const AllocationCounts kDrawAllocations = allocation_counts(AllocationPhase::kDraw);
+      stats += "simulation allocations: " + std::to_string(kFrame.allocations_per_tick.allocations) + " (" +
+               std::to_string(kFrame.allocations_per_tick.bytes) + " bytes) per tick\n" +
+               "draw allocations: " +
+               std::to_string(kDrawAllocations.allocations - previous_draw_allocations.allocations) + " (" +
+               std::to_string(kDrawAllocations.bytes - previous_draw_allocations.bytes) + " bytes) per frame\n";
+      previous_draw_allocations = kDrawAllocations;
     }
+    stats_text.setString(stats);
 
-    update_boids(boids, final_predators, kDt, window);
-    draw_boids(boids, window, debug_boid_drawing);
-    draw_predators(final_predators, window);
-
+    window.setView(hud_view);
     window.draw(help_text);
+    window.draw(stats_text);
 
     window.display();
 
   }
+
+  simulation.stop();
 };
@@ -0,0 +1,118 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "spatial_grid.h"
+
+constexpr std::array<unsigned int, 10> UpdateMetrics::kNeighbourBuckets;
+
+namespace {
+
+void write_metric(std::ostream& stream,
+                  const std::string& name,
+                  const std::string& type,
+                  const std::string& help,
+                  unsigned long value) {
+  stream << "# HELP " << name << " " << help << "\n"
+         << "# TYPE " << name << " " << type << "\n"
+         << name << " " << value << "\n";
+}
+
+}  // namespace
+
+void UpdateMetrics::add_boid(unsigned int tested,
+                             unsigned int cohesion,
+                             unsigned int alignment,
+                             unsigned int separation) {
+  ++boids;
+  pairs_tested += tested;
+  cohesion_pairs += cohesion;
+  alignment_pairs += alignment;
+  separation_pairs += separation;
+  const auto kBucket = std::lower_bound(kNeighbourBuckets.begin(), kNeighbourBuckets.end(), cohesion);
+  ++neighbour_histogram[kBucket - kNeighbourBuckets.begin()];
+}
+
+void UpdateMetrics::add_escaping_boid() {
+  add_boid(0, 0, 0, 0);
+  ++escaping_boids;
+}
+
+UpdateMetrics& UpdateMetrics::operator+=(const UpdateMetrics& other) {
+  boids += other.boids;
+  pairs_tested += other.pairs_tested;
+  cohesion_pairs += other.cohesion_pairs;
+  alignment_pairs += other.alignment_pairs;
+  separation_pairs += other.separation_pairs;
+  escaping_boids += other.escaping_boids;
+  for (std::size_t i = 0; i < neighbour_histogram.size(); ++i) {
+    neighbour_histogram[i] += other.neighbour_histogram[i];
+  }
+  return *this;
+}
+
+GridOccupancy grid_occupancy(const SpatialGrid& grid) {
+  GridOccupancy occupancy;
+  /** Whole grid rather than the world, in an open world the grid follows the flock out of it */
+  const Vector2s kGridMax = grid.origin() + Vector2s(grid.size().x, grid.size().y);
+  grid.for_each_cell_in_rect(grid.origin(), kGridMax, [&](const Vector2s&, Scalar, unsigned int count) {
+    ++occupancy.cells;
+    occupancy.occupied_cells += count > 0;
+    occupancy.max_boids_per_cell = std::max(occupancy.max_boids_per_cell, count);
+  });
+  return occupancy;
+}
+
+void write_prometheus_metrics(const std::string& path,
+                              unsigned long ticks,
+                              const UpdateMetrics& totals,
+                              const UpdateMetrics& last_tick,
+                              const GridOccupancy& occupancy) {
+  const std::string kTemporaryPath = path + ".tmp";
+  {
+    std::ofstream file(kTemporaryPath);
+    if (!file) {
+      throw std::runtime_error("Cannot write metrics file " + kTemporaryPath);
+    }
+
+    write_metric(file, "boids_ticks_total", "counter", "Simulation ticks.", ticks);
+    write_metric(file, "boids_updates_total", "counter", "Boid updates.", totals.boids);
+    write_metric(file, "boids_pairs_tested_total", "counter",
+                 "Neighbour candidates checked against the cohesion distance.", totals.pairs_tested);
+    file << "# HELP boids_pairs_accepted_total Neighbour pairs within the rule radius.\n"
+         << "# TYPE boids_pairs_accepted_total counter\n"
+         << "boids_pairs_accepted_total{radius=\"cohesion\"} " << totals.cohesion_pairs << "\n"
+         << "boids_pairs_accepted_total{radius=\"alignment\"} " << totals.alignment_pairs << "\n"
+         << "boids_pairs_accepted_total{radius=\"separation\"} " << totals.separation_pairs << "\n";
+
+    file << "# HELP boids_neighbours_per_boid Flockmates within cohesion distance per boid update.\n"
+         << "# TYPE boids_neighbours_per_boid histogram\n";
+    unsigned long cumulative = 0;
+    for (std::size_t i = 0; i < UpdateMetrics::kNeighbourBuckets.size(); ++i) {
+      cumulative += totals.neighbour_histogram[i];
+      file << "boids_neighbours_per_boid_bucket{le=\"" << UpdateMetrics::kNeighbourBuckets[i] << "\"} "
+           << cumulative << "\n";
+    }
+    file << "boids_neighbours_per_boid_bucket{le=\"+Inf\"} " << totals.boids << "\n"
+         << "boids_neighbours_per_boid_sum " << totals.cohesion_pairs << "\n"
+         << "boids_neighbours_per_boid_count " << totals.boids << "\n";
+
+    write_metric(file, "boids_boids", "gauge", "Boids in the last tick.", last_tick.boids);
+    write_metric(file, "boids_escaping_boids", "gauge", "Boids running from predators in the last tick.",
+                 last_tick.escaping_boids);
+    write_metric(file, "boids_grid_cells", "gauge", "Spatial grid cells.", occupancy.cells);
+    write_metric(file, "boids_grid_occupied_cells", "gauge", "Spatial grid cells holding boids.",
+                 occupancy.occupied_cells);
+    write_metric(file, "boids_grid_max_boids_per_cell", "gauge", "Boids in the fullest spatial grid cell.",
+                 occupancy.max_boids_per_cell);
+    if (!file) {
+      throw std::runtime_error("Cannot write metrics file " + kTemporaryPath);
+    }
+  }
+
+  if (std::rename(kTemporaryPath.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Cannot replace metrics file " + path);
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+class SpatialGrid;
+
+/**
+ * Work counters gathered by update_boids, used for capacity planning.
+ *
+ * Boids count into locals while they update and only add them here once per boid, so the counters cost next to
+ * nothing when enabled and a single branch per boid when not.
+ */
+struct UpdateMetrics {
+  /** Upper bounds of the neighbours per boid histogram buckets, the last bucket (+Inf) is implicit */
+  static constexpr std::array<unsigned int, 10> kNeighbourBuckets = {{0, 1, 2, 4, 8, 16, 32, 64, 128, 256}};
+
+  unsigned long boids = 0;
+  /** Candidates from the grid checked against the cohesion distance, in topological mode only accepted ones */
+  unsigned long pairs_tested = 0;
+  /** Accepted pairs by radius, every pair within alignment / separation distance is within cohesion distance too */
+  unsigned long cohesion_pairs = 0;
+  unsigned long alignment_pairs = 0;
+  unsigned long separation_pairs = 0;
+  /** Boids running from predators, these don't look at flockmates */
+  unsigned long escaping_boids = 0;
+  /** Number of boids by neighbours (cohesion pairs) per boid, not cumulative */
+  std::array<unsigned long, kNeighbourBuckets.size() + 1> neighbour_histogram = {};
+
+  /**
+   * Count updated boid.
+   *
+   * \param tested Candidates tested.
+   * \param cohesion Flockmates within cohesion distance.
+   * \param alignment Flockmates within alignment distance.
+   * \param separation Flockmates within separation distance.
+   */
+  void add_boid(unsigned int tested, unsigned int cohesion, unsigned int alignment, unsigned int separation);
+
+  /** Count boid which ran from predators instead of flocking */
+  void add_escaping_boid();
+
+  UpdateMetrics& operator+=(const UpdateMetrics& other);
+};
+
+/** Spatial grid occupancy snapshot */
+struct GridOccupancy {
+  unsigned int cells = 0;
+  unsigned int occupied_cells = 0;
+  unsigned int max_boids_per_cell = 0;
+};
+
+/**
+ * Measure grid occupancy over every cell of the grid.
+ *
+ * \param grid Grid.
+ * \return Occupancy.
+ */
+GridOccupancy grid_occupancy(const SpatialGrid& grid);
+
+/**
+ * Write metrics in Prometheus text exposition format, e.g. for the node exporter textfile collector.
+ *
+ * Written to a temporary file renamed over the target, so scrapers never see a partial file.
+ *
+ * \param path Target path.
+ * \param ticks Ticks since start.
+ * \param totals Counters summed since start.
+ * \param last_tick Counters of the last tick.
+ * \param occupancy Grid occupancy after the last tick.
+ */
+void write_prometheus_metrics(const std::string& path,
+                              unsigned long ticks,
+                              const UpdateMetrics& totals,
+                              const UpdateMetrics& last_tick,
+                              const GridOccupancy& occupancy);
@@ -0,0 +1,99 @@
+#include "obstacles.h"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "thread_pool.h"
+#include "utils.h"
+
+Scalar signed_distance(const Obstacle& obstacle, const Vector2s& position) {
+  const Vector2s kOffset = position - obstacle.center;
+  if (obstacle.shape == Obstacle::Shape::kCircle) {
+    return length(kOffset) - obstacle.radius;
+  }
+
+  /** Distance outside of the rectangle plus (negative) distance to the closest edge inside of it */
+  const Vector2s kEdge(std::abs(kOffset.x) - obstacle.half_size.x, std::abs(kOffset.y) - obstacle.half_size.y);
+  const Vector2s kOutside(std::max(kEdge.x, Scalar(0)), std::max(kEdge.y, Scalar(0)));
+  return length(kOutside) + std::min(std::max(kEdge.x, kEdge.y), Scalar(0));
+}
+
+Obstacles load_obstacles(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot open obstacles file " + path);
+  }
+
+  Obstacles obstacles;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    std::istringstream stream(line.substr(0, line.find('#')));
+    std::string shape;
+    if (!(stream >> shape)) {
+      continue;
+    }
+
+    const std::string kOrigin = path + ":" + std::to_string(line_number);
+    Obstacle obstacle;
+    if (shape == "circle") {
+      obstacle.shape = Obstacle::Shape::kCircle;
+      if (!(stream >> obstacle.center.x >> obstacle.center.y >> obstacle.radius) || obstacle.radius <= 0) {
+        throw std::runtime_error(kOrigin + ": expected circle <center x> <center y> <radius>");
+      }
+    } else if (shape == "rectangle") {
+      Vector2s top_left;
+      Vector2s size;
+      if (!(stream >> top_left.x >> top_left.y >> size.x >> size.y) || size.x <= 0 || size.y <= 0) {
+        throw std::runtime_error(kOrigin + ": expected rectangle <left> <top> <width> <height>");
+      }
+      obstacle.shape = Obstacle::Shape::kRectangle;
+      obstacle.half_size = size / Scalar(2);
+      obstacle.center = top_left + obstacle.half_size;
+    } else {
+      throw std::runtime_error(kOrigin + ": unknown obstacle \"" + shape + "\"");
+    }
+
+    std::string rest;
+    if (stream >> rest) {
+      throw std::runtime_error(kOrigin + ": unexpected \"" + rest + "\"");
+    }
+    obstacles.push_back(obstacle);
+  }
+  return obstacles;
+}
+
+void ObstacleField::bake(const Obstacles& obstacles,
+                         const Vector2u& world_size,
+                         Scalar cell_size,
+                         ThreadPool& thread_pool) {
+  distances_.clear();
+  if (obstacles.empty()) {
+    return;
+  }
+
+  cell_size_ = cell_size;
+  columns_ = std::max(1, static_cast<int>(std::ceil(world_size.x / cell_size_)));
+  rows_ = std::max(1, static_cast<int>(std::ceil(world_size.y / cell_size_)));
+  distances_.resize((columns_ + 1) * (rows_ + 1));
+  /** Brute force over every obstacle, only done once at startup */
+  thread_pool.parallel_for(rows_ + 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t row = begin; row < end; ++row) {
+      for (int column = 0; column <= columns_; ++column) {
+        const Vector2s kPosition(column * cell_size_, row * cell_size_);
+        Scalar distance = std::numeric_limits<Scalar>::max();
+        for (const Obstacle& kObstacle : obstacles) {
+          distance = std::min(distance, signed_distance(kObstacle, kPosition));
+        }
+        distances_[row * (columns_ + 1) + column] = distance;
+      }
+    }
+  });
+}
+
+bool ObstacleField::empty() const {
+  return distances_.empty();
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "scalar.h"
+
+class ThreadPool;
+
+/** Static obstacle boids steer around */
+struct Obstacle {
+  enum class Shape {
+    kCircle,
+    kRectangle,
+  };
+
+  Shape shape = Shape::kCircle;
+  Vector2s center;
+  /** Circle radius */
+  Scalar radius = 0;
+  /** Half of the rectangle size */
+  Vector2s half_size;
+};
+
+using Obstacles = std::vector<Obstacle>;
+
+/**
+ * Signed distance from position to the obstacle outline, negative inside of it.
+ *
+ * \param obstacle Obstacle.
+ * \param position Position in world coordinates.
+ * \return Distance.
+ */
+Scalar signed_distance(const Obstacle& obstacle, const Vector2s& position);
+
+/**
+ * Load obstacles from a text file, one obstacle per line, "#" starts a comment:
+ *   circle <center x> <center y> <radius>
+ *   rectangle <left> <top> <width> <height>
+ *
+ * \param path Path to the file.
+ * \return Obstacles.
+ */
+Obstacles load_obstacles(const std::string& path);
+
+/**
+ * Signed distance field of all obstacles, sampled on a regular grid over the world and baked once.
+ *
+ * A lookup costs the same however many obstacles there are: bilinear interpolation of the four surrounding samples,
+ * which also gives the gradient (the direction away from the closest obstacle).
+ */
+class ObstacleField {
+ public:
+  /** Interpolated field value */
+  struct Sample {
+    /** Signed distance to the closest obstacle, negative inside */
+    Scalar distance;
+    /** Gradient of the distance, points away from the closest obstacle, roughly unit length */
+    Vector2s gradient;
+  };
+
+  /**
+   * Bake field, replacing the previous one.
+   *
+   * \param obstacles Obstacles.
+   * \param world_size World size, positions outside of the world take the value at the closest edge.
+   * \param cell_size Distance between samples, obstacles smaller than this get rounded.
+   * \param thread_pool Thread pool the sample rows are split across.
+   */
+  void bake(const Obstacles& obstacles, const Vector2u& world_size, Scalar cell_size, ThreadPool& thread_pool);
+
+  /** True if nothing was baked or there are no obstacles, sample must not be called then */
+  bool empty() const;
+
+  /**
+   * Field value at given position.
+   *
+   * \param position Position in world coordinates.
+   * \return Distance and gradient.
+   */
+  Sample sample(const Vector2s& position) const {
+    const Scalar kX = std::min(std::max(position.x / cell_size_, Scalar(0)), Scalar(columns_));
+    const Scalar kY = std::min(std::max(position.y / cell_size_, Scalar(0)), Scalar(rows_));
+    const int kColumn = std::min(static_cast<int>(kX), columns_ - 1);
+    const int kRow = std::min(static_cast<int>(kY), rows_ - 1);
+    const Scalar kTx = kX - kColumn;
+    const Scalar kTy = kY - kRow;
+
+    const Scalar* const kTop = &distances_[kRow * (columns_ + 1) + kColumn];
+    const Scalar* const kBottom = kTop + columns_ + 1;
+    const Scalar kTopValue = kTop[0] + (kTop[1] - kTop[0]) * kTx;
+    const Scalar kBottomValue = kBottom[0] + (kBottom[1] - kBottom[0]) * kTx;
+    const Scalar kLeftValue = kTop[0] + (kBottom[0] - kTop[0]) * kTy;
+    const Scalar kRightValue = kTop[1] + (kBottom[1] - kTop[1]) * kTy;
+    return Sample{kTopValue + (kBottomValue - kTopValue) * kTy,
+                  Vector2s(kRightValue - kLeftValue, kBottomValue - kTopValue) / cell_size_};
+  }
+ private:
+  Scalar cell_size_ = 1;
+  int columns_ = 0;
+  int rows_ = 0;
+  /** (columns_ + 1) x (rows_ + 1) samples, row by row, sample (column, row) is at (column, row) * cell_size_ */
+  std::vector<Scalar> distances_;
+};
@@ -0,0 +1,32 @@
+#include "packed_boids.h"
+
+#include <algorithm>
+#include <cmath>
+#include "boid.h"
+#include "spatial_grid.h"
+
+constexpr Scalar PackedBoids::kPositionSteps;
+constexpr Scalar PackedBoids::kHeadingSteps;
+
+void PackedBoids::pack(const Boids& boids, const SpatialGrid& grid) {
+  position_step_ = grid.cell_size() / kPositionSteps;
+  const Scalar kStepsPerUnit = kPositionSteps / grid.cell_size();
+  /** Resize keeps the capacity, packing only allocates when the flock grows */
+  entries_.resize(boids.size());
+  for (std::size_t i = 0; i < boids.size(); ++i) {
+    const Vector2s kPosition = boids[i].position();
+    const Vector2s kOffset = kPosition - grid.cell_origin(kPosition);
+    Entry& entry = entries_[i];
+    entry.x = static_cast<std::uint16_t>(std::min(std::max(std::round(kOffset.x * kStepsPerUnit), Scalar(0)),
+                                                  kPositionSteps));
+    entry.y = static_cast<std::uint16_t>(std::min(std::max(std::round(kOffset.y * kStepsPerUnit), Scalar(0)),
+                                                  kPositionSteps));
+    /** Full turn wraps to 0 */
+    entry.heading =
+      static_cast<std::uint16_t>(static_cast<std::uint32_t>(std::round(boids[i].rotation() * (kHeadingSteps / 360))));
+  }
+}
+
+std::size_t PackedBoids::size() const {
+  return entries_.size();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "scalar.h"
+
+class Boid;
+using Boids = std::vector<Boid>;
+class SpatialGrid;
+
+/**
+ * Compact read-only copy of the flock for neighbour scans, 6 bytes per boid instead of a whole Boid.
+ *
+ * Positions are 16 bit fixed point relative to the top left corner of the grid cell the boid is stored in, so the
+ * resolution is cell size / 65535 wherever the boid is in the world. Headings are 16 bit fractions of a full turn.
+ */
+class PackedBoids {
+ public:
+  /** Fixed point steps per cell size and per full turn */
+  static constexpr Scalar kPositionSteps = 65535;
+  static constexpr Scalar kHeadingSteps = 65536;
+
+  /**
+   * Pack boids, replacing the previous content.
+   *
+   * \param boids Boids, indices stay the same.
+   * \param grid Grid built from boids, decides the cell every position is relative to.
+   */
+  void pack(const Boids& boids, const SpatialGrid& grid);
+
+  /**
+   * Position of boid.
+   *
+   * \param index Boid index.
+   * \param cell_origin Top left corner of the grid cell the boid is stored in.
+   * \return Position in world coordinates.
+   */
+  Vector2s position(unsigned int index, const Vector2s& cell_origin) const {
+    const Entry& kEntry = entries_[index];
+    return Vector2s(cell_origin.x + kEntry.x * position_step_, cell_origin.y + kEntry.y * position_step_);
+  }
+
+  /**
+   * Position of boid relative to given point.
+   *
+   * Cheaper than position() - origin in scans, the cell corner relative to origin is the same for the whole cell.
+   *
+   * \param index Boid index.
+   * \param cell_origin Top left corner of the grid cell the boid is stored in.
+   * \param origin Point in world coordinates.
+   * \return Offset.
+   */
+  Vector2s offset(unsigned int index, const Vector2s& cell_origin, const Vector2s& origin) const {
+    const Entry& kEntry = entries_[index];
+    return (cell_origin - origin) + Vector2s(kEntry.x * position_step_, kEntry.y * position_step_);
+  }
+
+  /**
+   * Rotation of boid.
+   *
+   * \param index Boid index.
+   * \return Rotation in degrees <0, 360).
+   */
+  Scalar rotation(unsigned int index) const {
+    return entries_[index].heading * (360 / kHeadingSteps);
+  }
+
+  std::size_t size() const;
+ private:
+  struct Entry {
+    std::uint16_t x;
+    std::uint16_t y;
+    std::uint16_t heading;
+  };
+
+  std::vector<Entry> entries_;
+  /** Distance between neighbouring representable positions, the position error is at most half of it */
+  Scalar position_step_ = 1;
+};
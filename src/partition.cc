@@ -0,0 +1,533 @@
+#include "partition.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include "frame_arena.h"
+#include "simulation.h"
+
+static_assert(std::is_trivially_copyable<Boid>::value, "Boids are sent between processes as raw bytes");
+static_assert(std::is_trivially_copyable<PartitionStats>::value, "Stats are sent between processes as raw bytes");
+
+namespace {
+
+/** Command sent by the coordinator to every worker, kStep is followed by the partition edges */
+struct ControlCommand {
+  enum class Type : std::uint32_t {
+    kStep,
+    kStop,
+  };
+
+  Type type = Type::kStep;
+  float dt = 0;
+};
+
+void write_all(int socket, const void* data, std::size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t kWritten = send(socket, bytes, size, MSG_NOSIGNAL);
+    if (kWritten < 0 && errno == EINTR) {
+      continue;
+    }
+    if (kWritten <= 0) {
+      throw std::runtime_error("Cannot write to partition socket");
+    }
+    bytes += kWritten;
+    size -= kWritten;
+  }
+}
+
+void read_all(int socket, void* data, std::size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t kRead = recv(socket, bytes, size, 0);
+    if (kRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (kRead <= 0) {
+      throw std::runtime_error("Partition socket closed");
+    }
+    bytes += kRead;
+    size -= kRead;
+  }
+}
+
+std::array<int, 2> make_socket_pair() {
+  std::array<int, 2> sockets;
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets.data()) != 0) {
+    throw std::runtime_error("Cannot create partition socket pair");
+  }
+  return sockets;
+}
+
+/**
+ * Send a batch of boids to every peer and receive one batch from every peer.
+ *
+ * Sockets are non-blocking and serviced with poll, so batches larger than the socket buffers can't deadlock
+ * workers which all send before they receive.
+ *
+ * \param peers Socket connected to every partition, -1 for the calling one.
+ * \param outgoing Boids to send to every partition.
+ * \param incoming Boids received from all peers are appended here.
+ */
+void exchange_boids(const std::vector<int>& peers, const std::vector<Boids>& outgoing, Boids& incoming) {
+  struct Transfer {
+    std::vector<char> send_buffer;
+    std::size_t sent = 0;
+    std::uint64_t receive_count = 0;
+    std::size_t header_received = 0;
+    Boids received;
+    std::size_t payload_received = 0;
+    bool done_receiving = false;
+  };
+
+  std::vector<Transfer> transfers(peers.size());
+  for (std::size_t peer = 0; peer < peers.size(); ++peer) {
+    if (peers[peer] < 0) {
+      continue;
+    }
+
+    const std::uint64_t kCount = outgoing[peer].size();
+    std::vector<char>& buffer = transfers[peer].send_buffer;
+    buffer.resize(sizeof(kCount) + kCount * sizeof(Boid));
+    std::copy_n(reinterpret_cast<const char*>(&kCount), sizeof(kCount), buffer.data());
+    std::copy_n(reinterpret_cast<const char*>(outgoing[peer].data()), kCount * sizeof(Boid),
+                buffer.data() + sizeof(kCount));
+  }
+
+  std::vector<pollfd> descriptors;
+  std::vector<std::size_t> descriptor_peers;
+  while (true) {
+    descriptors.clear();
+    descriptor_peers.clear();
+    for (std::size_t peer = 0; peer < peers.size(); ++peer) {
+      const Transfer& kTransfer = transfers[peer];
+      if (peers[peer] < 0) {
+        continue;
+      }
+
+      const short kEvents = (kTransfer.sent < kTransfer.send_buffer.size() ? POLLOUT : 0) |
+                            (kTransfer.done_receiving ? 0 : POLLIN);
+      if (kEvents != 0) {
+        descriptors.push_back(pollfd{peers[peer], kEvents, 0});
+        descriptor_peers.push_back(peer);
+      }
+    }
+
+    if (descriptors.empty()) {
+      break;
+    }
+
+    if (poll(descriptors.data(), descriptors.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Cannot poll partition sockets");
+    }
+
+    for (std::size_t i = 0; i < descriptors.size(); ++i) {
+      Transfer& transfer = transfers[descriptor_peers[i]];
+      const int kSocket = descriptors[i].fd;
+      if (descriptors[i].revents & POLLOUT) {
+        const ssize_t kWritten = send(kSocket, transfer.send_buffer.data() + transfer.sent,
+                                      transfer.send_buffer.size() - transfer.sent, MSG_NOSIGNAL);
+        if (kWritten < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          throw std::runtime_error("Cannot write to partition socket");
+        }
+        transfer.sent += std::max<ssize_t>(kWritten, 0);
+      }
+
+      if (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        char* destination;
+        std::size_t remaining;
+        if (transfer.header_received < sizeof(transfer.receive_count)) {
+          destination = reinterpret_cast<char*>(&transfer.receive_count) + transfer.header_received;
+          remaining = sizeof(transfer.receive_count) - transfer.header_received;
+        } else {
+          destination = reinterpret_cast<char*>(transfer.received.data()) + transfer.payload_received;
+          remaining = transfer.received.size() * sizeof(Boid) - transfer.payload_received;
+        }
+
+        const ssize_t kRead = recv(kSocket, destination, remaining, 0);
+        if (kRead == 0) {
+          throw std::runtime_error("Partition socket closed");
+        }
+        if (kRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          throw std::runtime_error("Cannot read from partition socket");
+        }
+
+        const std::size_t kReadBytes = std::max<ssize_t>(kRead, 0);
+        if (transfer.header_received < sizeof(transfer.receive_count)) {
+          transfer.header_received += kReadBytes;
+          if (transfer.header_received == sizeof(transfer.receive_count)) {
+            transfer.received.resize(transfer.receive_count);
+          }
+        } else {
+          transfer.payload_received += kReadBytes;
+        }
+        transfer.done_receiving = transfer.header_received == sizeof(transfer.receive_count) &&
+                                  transfer.payload_received == transfer.received.size() * sizeof(Boid);
+      }
+    }
+  }
+
+  for (const Transfer& kTransfer : transfers) {
+    incoming.insert(incoming.end(), kTransfer.received.begin(), kTransfer.received.end());
+  }
+}
+
+/** Worker process side of PartitionedSimulation */
+class PartitionWorker {
+ public:
+  PartitionWorker(const AppConfig& config,
+                  const Vector2u& world_size,
+                  unsigned int index,
+                  const PartitionEdges& edges,
+                  int control_socket,
+                  const std::vector<int>& peers)
+    : config_(config),
+      world_size_(world_size),
+      index_(index),
+      edges_(edges),
+      control_socket_(control_socket),
+      peers_(peers),
+      thread_pool_(config.threads) {
+    /** Every worker places its share of boids in its own strip */
+    const unsigned int kPartitions = edges.size() - 1;
+    const unsigned int kCount =
+      config.startup_boid_count / kPartitions + (index < config.startup_boid_count % kPartitions ? 1 : 0);
+    RandomGenerator random = make_random_generator(config.seed ? config.seed + index : 0);
+    Boids boids(kCount);
+    randomize_boids(boids, world_size, random);
+    const float kBegin = edges_[index_];
+    const float kWidth = edges_[index_ + 1] - kBegin;
+    for (const Boid& kBoid : boids) {
+      const Vector2s kPosition(kBegin + kBoid.position().x * kWidth / world_size.x, kBoid.position().y);
+      boids_.push_back(Boid(kPosition, kBoid.rotation()));
+    }
+
+    /** Every worker bakes the whole field, boids may migrate anywhere */
+    load_obstacle_field(config, world_size, thread_pool_, obstacle_field_);
+    Boid::set_obstacle_field(&obstacle_field_);
+    reset_flow_field(config, world_size, obstacle_field_, thread_pool_, flow_field_);
+    Boid::set_flow_field(&flow_field_);
+  }
+
+  /** Process commands until told to stop */
+  void run() {
+    while (true) {
+      ControlCommand command;
+      read_all(control_socket_, &command, sizeof(command));
+      if (command.type == ControlCommand::Type::kStop) {
+        return;
+      }
+
+      read_all(control_socket_, edges_.data(), edges_.size() * sizeof(float));
+      const PartitionStats kStats = step(command.dt);
+      write_all(control_socket_, &kStats, sizeof(kStats));
+    }
+  }
+ private:
+  PartitionStats step(float dt) {
+    FrameArena::for_current_thread().reset();
+    PartitionStats stats;
+    migrate(stats);
+    gather_halo(stats);
+
+    if (config_.morton_sort_interval > 0 && tick_ % config_.morton_sort_interval == 0) {
+      sort_boids_spatially(boids_, world_size_);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point kStart = Clock::now();
+    update_boids(boids_, halo_, grid_, Predators(), dt, world_size_, thread_pool_, nullptr, &neighbour_counts_);
+    stats.update_ms = std::chrono::duration<double, std::milli>(Clock::now() - kStart).count();
+    stats.boids = boids_.size();
+    stats.load.fill(0);
+    const float kColumnsPerUnit = static_cast<float>(kPartitionLoadColumns) / world_size_.x;
+    for (std::size_t i = 0; i < boids_.size(); ++i) {
+      const auto kColumn = static_cast<unsigned int>(std::max<Scalar>(boids_[i].position().x * kColumnsPerUnit, 0));
+      stats.load[std::min(kColumn, kPartitionLoadColumns - 1)] += 1 + neighbour_counts_[i];
+      stats.neighbour_pairs += neighbour_counts_[i];
+    }
+    ++tick_;
+    return stats;
+  }
+
+  void migrate(PartitionStats& stats) {
+    for (Boids& outgoing : outgoing_) {
+      outgoing.clear();
+    }
+    outgoing_.resize(peers_.size());
+
+    Boids kept;
+    kept.reserve(boids_.size());
+    for (const Boid& kBoid : boids_) {
+      const unsigned int kOwner = partition_of(edges_, kBoid.position().x);
+      if (kOwner == index_) {
+        kept.push_back(kBoid);
+      } else {
+        outgoing_[kOwner].push_back(kBoid);
+      }
+    }
+    boids_.swap(kept);
+
+    const std::size_t kOwnCount = boids_.size();
+    exchange_boids(peers_, outgoing_, boids_);
+    stats.migrated_boids = boids_.size() - kOwnCount;
+  }
+
+  void gather_halo(PartitionStats& stats) {
+    for (Boids& outgoing : outgoing_) {
+      outgoing.clear();
+    }
+
+    /** Only boids within cohesion distance of the own strip edges can be within cohesion distance of another one */
+    const float kCohesionDistance = Boid::config().size * Boid::config().cohesion_distance_factor;
+    const float kBegin = edges_[index_];
+    const float kEnd = edges_[index_ + 1];
+    for (const Boid& kBoid : boids_) {
+      const Scalar kX = kBoid.position().x;
+      if (kX >= kBegin + kCohesionDistance && kX < kEnd - kCohesionDistance) {
+        continue;
+      }
+
+      /** Neighbour search may wrap around the world, the first and the last strip are then neighbours too */
+      const Scalar kWorldWidth = Boid::config().boundary == BoundaryMode::kWrap ? world_size_.x : 0;
+      for (unsigned int peer = 0; peer < peers_.size(); ++peer) {
+        const Scalar kPeerBegin = edges_[peer] - kCohesionDistance;
+        const Scalar kPeerEnd = edges_[peer + 1] + kCohesionDistance;
+        if (peer != index_ && ((kX >= kPeerBegin && kX < kPeerEnd) ||
+                               (kX - kWorldWidth >= kPeerBegin && kX - kWorldWidth < kPeerEnd) ||
+                               (kX + kWorldWidth >= kPeerBegin && kX + kWorldWidth < kPeerEnd))) {
+          outgoing_[peer].push_back(kBoid);
+        }
+      }
+    }
+
+    halo_.clear();
+    exchange_boids(peers_, outgoing_, halo_);
+    stats.halo_boids = halo_.size();
+  }
+
+  const AppConfig& config_;
+  Vector2u world_size_;
+  unsigned int index_;
+  PartitionEdges edges_;
+  int control_socket_;
+  std::vector<int> peers_;
+  ThreadPool thread_pool_;
+  Boids boids_;
+  Boids halo_;
+  /** Flockmates of every own boid in the last step, by boid index */
+  std::vector<unsigned int> neighbour_counts_;
+  std::vector<Boids> outgoing_;
+  SpatialGrid grid_;
+  ObstacleField obstacle_field_;
+  FlowField flow_field_;
+  unsigned long tick_ = 0;
+};
+
+}  // namespace
+
+PartitionEdges split_world_evenly(unsigned int count, const Vector2u& world_size) {
+  PartitionEdges edges(count + 1);
+  for (unsigned int i = 0; i <= count; ++i) {
+    edges[i] = static_cast<float>(world_size.x) * i / count;
+  }
+  return edges;
+}
+
+unsigned int partition_of(const PartitionEdges& edges, float x) {
+  const auto kEdge = std::upper_bound(edges.begin() + 1, edges.end() - 1, x);
+  return static_cast<unsigned int>(kEdge - edges.begin() - 1);
+}
+
+PartitionEdges balance_edges(const PartitionLoadProfile& load, unsigned int count, const Vector2u& world_size) {
+  double total = 0;
+  for (float column_load : load) {
+    total += column_load;
+  }
+  if (total <= 0) {
+    return split_world_evenly(count, world_size);
+  }
+
+  PartitionEdges edges(count + 1);
+  edges.front() = 0;
+  edges.back() = world_size.x;
+  const float kColumnWidth = static_cast<float>(world_size.x) / kPartitionLoadColumns;
+  double prefix = 0;
+  unsigned int column = 0;
+  for (unsigned int i = 1; i < count; ++i) {
+    const double kTarget = total * i / count;
+    while (column < kPartitionLoadColumns - 1 && prefix + load[column] < kTarget) {
+      prefix += load[column];
+      ++column;
+    }
+
+    const double kFraction = load[column] > 0 ? std::min(1.0, (kTarget - prefix) / load[column]) : 0;
+    edges[i] = std::max(edges[i - 1], static_cast<float>((column + kFraction) * kColumnWidth));
+  }
+  return edges;
+}
+
+PartitionedSimulation::PartitionedSimulation(const AppConfig& config, const Vector2u& world_size)
+  : balance_interval_(config.balance_interval),
+    balance_threshold_(config.balance_threshold),
+    world_size_(world_size),
+    edges_(split_world_evenly(std::max(config.partitions, 1u), world_size)),
+    stats_(edges_.size() - 1),
+    balance_partition_load_(edges_.size() - 1) {
+  const unsigned int kCount = edges_.size() - 1;
+
+  /** Full mesh, peer_sockets[i][j] is the end held by worker i of the socket connecting it with worker j */
+  std::vector<std::vector<int>> peer_sockets(kCount, std::vector<int>(kCount, -1));
+  std::vector<int> worker_control_sockets(kCount);
+  std::vector<int> all_sockets;
+  for (unsigned int i = 0; i < kCount; ++i) {
+    for (unsigned int j = i + 1; j < kCount; ++j) {
+      const std::array<int, 2> kPair = make_socket_pair();
+      peer_sockets[i][j] = kPair[0];
+      peer_sockets[j][i] = kPair[1];
+      fcntl(kPair[0], F_SETFL, O_NONBLOCK);
+      fcntl(kPair[1], F_SETFL, O_NONBLOCK);
+      all_sockets.insert(all_sockets.end(), kPair.begin(), kPair.end());
+    }
+
+    const std::array<int, 2> kControl = make_socket_pair();
+    control_sockets_.push_back(kControl[0]);
+    worker_control_sockets[i] = kControl[1];
+    all_sockets.insert(all_sockets.end(), kControl.begin(), kControl.end());
+  }
+
+  /** Buffered output would be written once by every process */
+  std::cout.flush();
+  std::fflush(nullptr);
+
+  for (unsigned int i = 0; i < kCount; ++i) {
+    const pid_t kPid = fork();
+    if (kPid < 0) {
+      stop();
+      throw std::runtime_error("Cannot fork partition worker");
+    }
+
+    if (kPid == 0) {
+      /** Close every socket end owned by someone else, so a dead process is seen as a closed socket */
+      for (int socket : all_sockets) {
+        if (socket != worker_control_sockets[i] &&
+            std::find(peer_sockets[i].begin(), peer_sockets[i].end(), socket) == peer_sockets[i].end()) {
+          close(socket);
+        }
+      }
+
+      int status = 0;
+      try {
+        PartitionWorker worker(config, world_size, i, edges_, worker_control_sockets[i], peer_sockets[i]);
+        worker.run();
+      } catch (const std::exception& exception) {
+        std::cerr << "Partition worker " << i << ": " << exception.what() << std::endl;
+        status = 1;
+      }
+      _exit(status);
+    }
+
+    workers_.push_back(kPid);
+  }
+
+  for (int socket : all_sockets) {
+    if (std::find(control_sockets_.begin(), control_sockets_.end(), socket) == control_sockets_.end()) {
+      close(socket);
+    }
+  }
+}
+
+PartitionedSimulation::~PartitionedSimulation() {
+  stop();
+}
+
+const std::vector<PartitionStats>& PartitionedSimulation::step(float dt) {
+  ControlCommand command;
+  command.type = ControlCommand::Type::kStep;
+  command.dt = dt;
+  for (int socket : control_sockets_) {
+    write_all(socket, &command, sizeof(command));
+    write_all(socket, edges_.data(), edges_.size() * sizeof(float));
+  }
+
+  double max_load = 0;
+  double total_load = 0;
+  for (std::size_t i = 0; i < control_sockets_.size(); ++i) {
+    read_all(control_sockets_[i], &stats_[i], sizeof(PartitionStats));
+    const double kLoad = stats_[i].boids + stats_[i].neighbour_pairs;
+    max_load = std::max(max_load, kLoad);
+    total_load += kLoad;
+    balance_partition_load_[i] += kLoad;
+    for (unsigned int column = 0; column < kPartitionLoadColumns; ++column) {
+      balance_load_[column] += stats_[i].load[column];
+    }
+  }
+  load_imbalance_ = total_load > 0 ? max_load * stats_.size() / total_load : 1;
+
+  ++tick_;
+  if (balance_interval_ > 0 && tick_ % balance_interval_ == 0) {
+    balance();
+  }
+  return stats_;
+}
+
+const PartitionEdges& PartitionedSimulation::edges() const {
+  return edges_;
+}
+
+float PartitionedSimulation::load_imbalance() const {
+  return load_imbalance_;
+}
+
+unsigned int PartitionedSimulation::rebalance_count() const {
+  return rebalance_count_;
+}
+
+void PartitionedSimulation::balance() {
+  /** Imbalance over the whole period, a single tick is too noisy to act on */
+  const double kMaxLoad = *std::max_element(balance_partition_load_.begin(), balance_partition_load_.end());
+  double total_load = 0;
+  for (double load : balance_partition_load_) {
+    total_load += load;
+  }
+
+  /** Hysteresis, moving edges costs a burst of migration so small imbalances are left alone */
+  if (total_load > 0 && kMaxLoad * balance_partition_load_.size() / total_load > balance_threshold_) {
+    edges_ = balance_edges(balance_load_, edges_.size() - 1, world_size_);
+    ++rebalance_count_;
+  }
+
+  balance_load_.fill(0);
+  std::fill(balance_partition_load_.begin(), balance_partition_load_.end(), 0);
+}
+
+void PartitionedSimulation::stop() {
+  ControlCommand command;
+  command.type = ControlCommand::Type::kStop;
+  for (int socket : control_sockets_) {
+    /** Worker may be gone already, nothing to report from a destructor */
+    send(socket, &command, sizeof(command), MSG_NOSIGNAL);
+    close(socket);
+  }
+  control_sockets_.clear();
+
+  for (pid_t worker : workers_) {
+    waitpid(worker, nullptr, 0);
+  }
+  workers_.clear();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <sys/types.h>
+#include <array>
+#include <vector>
+#include "config.h"
+#include "vector2.h"
+
+/**
+ * Edges of the vertical strips the world is split into, partition i owns boids with x in [edges[i], edges[i + 1]).
+ *
+ * First edge is 0 and the last one is the world width, boids exactly at the world width belong to the last strip.
+ */
+using PartitionEdges = std::vector<float>;
+
+/**
+ * Split world into strips of the same width.
+ *
+ * \param count Number of strips.
+ * \param world_size World size.
+ * \return Edges.
+ */
+PartitionEdges split_world_evenly(unsigned int count, const Vector2u& world_size);
+
+/**
+ * Find partition owning given x coordinate.
+ *
+ * \param edges Edges.
+ * \param x X coordinate in world coordinates.
+ * \return Partition index.
+ */
+unsigned int partition_of(const PartitionEdges& edges, float x);
+
+/** Resolution of the load profile used to place partition edges, in columns across the whole world */
+constexpr unsigned int kPartitionLoadColumns = 512;
+
+/** Load (boids plus neighbour pairs) of every column of the world */
+using PartitionLoadProfile = std::array<float, kPartitionLoadColumns>;
+
+/**
+ * Place edges so every partition gets the same share of the load, edges inside a column are interpolated.
+ *
+ * \param load Load profile.
+ * \param count Number of partitions.
+ * \param world_size World size.
+ * \return Edges.
+ */
+PartitionEdges balance_edges(const PartitionLoadProfile& load, unsigned int count, const Vector2u& world_size);
+
+/** Per tick report sent by every worker to the coordinator */
+struct PartitionStats {
+  /** Boids owned after the tick */
+  unsigned int boids = 0;
+  /** Boids received from other partitions as read-only neighbours */
+  unsigned int halo_boids = 0;
+  /** Boids received from other partitions because they crossed an edge */
+  unsigned int migrated_boids = 0;
+  /** Time spent in update_boids */
+  double update_ms = 0;
+  /** Flockmates steered by, summed over own boids */
+  unsigned long neighbour_pairs = 0;
+  /** Load of own boids by column of the world */
+  PartitionLoadProfile load = {};
+};
+
+/**
+ * Simulation split into vertical strips, every strip is simulated by its own worker process.
+ *
+ * Workers are forked on construction and connected with each other (and with the coordinating process) by Unix
+ * domain sockets, so it runs on a single Linux host. Every tick workers:
+ *   1. send boids which left their strip to the new owner (migration),
+ *   2. send boids within cohesion distance of another strip to its owner (halo),
+ *   3. update own boids with the halo as read-only flockmates,
+ *   4. report PartitionStats to the coordinator and wait for the next tick.
+ *
+ * With the wrap boundary neighbour search wraps around the world, so the halo of the first strip includes the end of
+ * the last one and the other way around. Boids outside of the world belong to the first or the last strip.
+ */
+class PartitionedSimulation {
+ public:
+  /**
+   * Fork workers, every one of them places its share of config.startup_boid_count boids in its strip.
+   *
+   * \param config Config, config.partitions is the number of workers and config.threads is per worker.
+   * \param world_size World size.
+   */
+  PartitionedSimulation(const AppConfig& config, const Vector2u& world_size);
+  /** Stop and reap workers */
+  ~PartitionedSimulation();
+
+  PartitionedSimulation(const PartitionedSimulation&) = delete;
+  PartitionedSimulation& operator=(const PartitionedSimulation&) = delete;
+
+  /**
+   * Run one tick on all workers, blocks until all of them are done.
+   *
+   * Every config.balance_interval ticks the edges are moved to even out the load measured since the last check,
+   * if the imbalance over that period was above config.balance_threshold.
+   *
+   * \param dt Delta time in seconds.
+   * \return Report of every worker, indexed by partition.
+   */
+  const std::vector<PartitionStats>& step(float dt);
+
+  const PartitionEdges& edges() const;
+
+  /** Load imbalance of the last tick, max / mean load of the partitions where load is boids plus neighbour pairs */
+  float load_imbalance() const;
+  /** Number of times the edges were moved */
+  unsigned int rebalance_count() const;
+ private:
+  void balance();
+  void stop();
+
+  unsigned int balance_interval_;
+  float balance_threshold_;
+  Vector2u world_size_;
+  PartitionEdges edges_;
+  std::vector<pid_t> workers_;
+  /** Coordinator end of the control socket of every worker */
+  std::vector<int> control_sockets_;
+  std::vector<PartitionStats> stats_;
+  unsigned long tick_ = 0;
+  float load_imbalance_ = 1;
+  unsigned int rebalance_count_ = 0;
+  /** Load accumulated since the last balance check */
+  PartitionLoadProfile balance_load_ = {};
+  std::vector<double> balance_partition_load_;
+};
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "partition.h"
+
+constexpr unsigned int kDefaultTicks = 300;
+
+AppConfig partitioned_defaults() {
+  AppConfig config;
+  config.startup_boid_count = 100000;
+  config.world_width = 32000;
+  config.world_height = 8000;
+  /** One thread per worker, processes are the unit of parallelism here */
+  config.threads = 1;
+  config.timestep = 1.0f / 60;
+  config.seed = 1;
+  return config;
+}
+
+/**
+ * Headless simulation split into vertical strips, one worker process per strip.
+ *
+ * Reports tick cost as seen by the coordinator (slowest worker plus exchange), the halo / migration traffic and
+ * the load imbalance (max / mean partition load) the edge balancing works against.
+ *
+ * Arguments:
+ *   --ticks=<n>  Number of ticks.
+ *   --per-tick   Print load imbalance and edges of every tick.
+ *   anything else is passed to the config loader, e.g. --partition.count=8
+ */
+int main(int argc, char* argv[]) {
+  unsigned int ticks = kDefaultTicks;
+  bool per_tick = false;
+  std::vector<char*> config_arguments = {argv[0]};
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--ticks=", 8) == 0) {
+      ticks = std::stoul(argv[i] + 8);
+    } else if (std::strcmp(argv[i], "--per-tick") == 0) {
+      per_tick = true;
+    } else {
+      config_arguments.push_back(argv[i]);
+    }
+  }
+
+  const AppConfig kConfig = load_config(config_arguments.size(), config_arguments.data(), partitioned_defaults());
+  Boid::set_config(kConfig.boid);
+
+  const Vector2u kWorldSize = headless_world_size(kConfig);
+  const float kDt = kConfig.timestep > 0 ? kConfig.timestep : 1.0f / 60;
+  PartitionedSimulation simulation(kConfig, kWorldSize);
+
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  double total_ms = 0;
+  unsigned long total_halo_boids = 0;
+  unsigned long total_migrated_boids = 0;
+  unsigned long boids = 0;
+  double total_imbalance = 0;
+  float max_imbalance = 0;
+  for (unsigned int i = 0; i < ticks; ++i) {
+    const Clock::time_point kStart = Clock::now();
+    const std::vector<PartitionStats>& kStats = simulation.step(kDt);
+    total_ms += Milliseconds(Clock::now() - kStart).count();
+
+    boids = 0;
+    for (const PartitionStats& kPartition : kStats) {
+      boids += kPartition.boids;
+      total_halo_boids += kPartition.halo_boids;
+      total_migrated_boids += kPartition.migrated_boids;
+    }
+
+    total_imbalance += simulation.load_imbalance();
+    max_imbalance = std::max(max_imbalance, simulation.load_imbalance());
+    if (per_tick) {
+      std::cout << "tick " << i << " load_imbalance " << simulation.load_imbalance() << " edges";
+      for (float edge : simulation.edges()) {
+        std::cout << " " << edge;
+      }
+      std::cout << "\n";
+    }
+
+    if (boids != kConfig.startup_boid_count) {
+      std::cerr << "Tick " << i << ": " << boids << " boids, expected " << kConfig.startup_boid_count << "\n";
+      return 1;
+    }
+  }
+
+  const double kAverageMs = ticks ? total_ms / ticks : 0;
+  std::cout << "partitions: " << simulation.edges().size() - 1 << "\n"
+            << "boids: " << boids << "\n"
+            << "ticks: " << ticks << "\n"
+            << "tick_ms: " << kAverageMs << "\n"
+            << "ticks_per_second: " << (kAverageMs > 0 ? 1000 / kAverageMs : 0) << "\n"
+            << "halo_boids_per_tick: " << (ticks ? total_halo_boids / ticks : 0) << "\n"
+            << "migrated_boids_per_tick: " << (ticks ? total_migrated_boids / ticks : 0) << "\n"
+            << "load_imbalance: " << (ticks ? total_imbalance / ticks : 0) << "\n"
+            << "max_load_imbalance: " << max_imbalance << "\n"
+            << "rebalances: " << simulation.rebalance_count() << "\n";
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace {
+
+#ifdef __linux__
+int open_counter(PerfCounters::Counter counter) {
+  perf_event_attr attributes;
+  std::memset(&attributes, 0, sizeof(attributes));
+  attributes.size = sizeof(attributes);
+  attributes.type = PERF_TYPE_HW_CACHE;
+  /** L2 is not a generic perf event, the last level cache is the closest portable stand-in */
+  const std::uint64_t kCache = counter == PerfCounters::Counter::kL1DataReadMisses ? PERF_COUNT_HW_CACHE_L1D
+                                                                                   : PERF_COUNT_HW_CACHE_LL;
+  attributes.config = kCache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attributes.disabled = 1;
+  attributes.inherit = 1;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+#endif
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+  for (Counter counter : counters()) {
+#ifdef __linux__
+    descriptors_.push_back(open_counter(counter));
+#else
+    (void)counter;
+    descriptors_.push_back(-1);
+#endif
+  }
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int descriptor : descriptors_) {
+    if (descriptor >= 0) {
+      close(descriptor);
+    }
+  }
+#endif
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+  for (int descriptor : descriptors_) {
+    if (descriptor >= 0) {
+      ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+      ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+void PerfCounters::stop() {
+#ifdef __linux__
+  for (int descriptor : descriptors_) {
+    if (descriptor >= 0) {
+      ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+#endif
+}
+
+bool PerfCounters::available(Counter counter) const {
+  return descriptors_[static_cast<std::size_t>(counter)] >= 0;
+}
+
+std::uint64_t PerfCounters::value(Counter counter) const {
+  std::uint64_t count = 0;
+#ifdef __linux__
+  const int kDescriptor = descriptors_[static_cast<std::size_t>(counter)];
+  if (kDescriptor >= 0 && read(kDescriptor, &count, sizeof(count)) != sizeof(count)) {
+    count = 0;
+  }
+#endif
+  return count;
+}
+
+std::string PerfCounters::name(Counter counter) {
+  switch (counter) {
+    case Counter::kL1DataReadMisses:
+      return "l1d_read_misses";
+    case Counter::kLastLevelCacheMisses:
+      return "llc_read_misses";
+  }
+  return "";
+}
+
+const std::vector<PerfCounters::Counter>& PerfCounters::counters() {
+  static const std::vector<Counter> kCounters = {Counter::kL1DataReadMisses, Counter::kLastLevelCacheMisses};
+  return kCounters;
+}
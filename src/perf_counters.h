@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Hardware cache counters of the calling thread and its children, read through Linux perf events.
+ *
+ * Counters the kernel or the machine doesn't provide are reported as unavailable instead of failing, so the
+ * benchmark still runs in containers and VMs.
+ */
+class PerfCounters {
+ public:
+  enum class Counter {
+    kL1DataReadMisses,
+    kLastLevelCacheMisses,
+  };
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  /** Reset and start all available counters */
+  void start();
+  /** Stop all counters */
+  void stop();
+
+  bool available(Counter counter) const;
+  /** Count since the last start, 0 if not available */
+  std::uint64_t value(Counter counter) const;
+
+  /** Name used in the benchmark report */
+  static std::string name(Counter counter);
+  static const std::vector<Counter>& counters();
+ private:
+  std::vector<int> descriptors_;
+};
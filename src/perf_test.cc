@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "allocation_tracker.h"
+#include "simulation.h"
+
+namespace {
+
+constexpr unsigned int kWarmupTicks = 20;
+constexpr unsigned int kDefaultTicks = 200;
+constexpr float kDt = 1.0f / 60;
+/** Allowed ticks per second drop below the baseline, as a fraction of the baseline */
+constexpr double kDefaultTolerance = 0.25;
+/** Allowed allocations per tick above the baseline, as a fraction of the baseline plus one allocation */
+constexpr double kAllocationTolerance = 0.1;
+
+/** Fixed seed headless workload */
+struct Scenario {
+  std::string name;
+  unsigned int boid_count;
+  Vector2u world_size;
+  /** Boids start inside this rect (min, max) */
+  Vector2f spawn_min;
+  Vector2f spawn_max;
+  unsigned int predator_count;
+};
+
+/** Measured scenario */
+struct Result {
+  double ticks_per_second = 0;
+  double allocations_per_tick = 0;
+};
+
+/** Values from the baselines file, missing scenarios are not gated */
+using Baselines = std::map<std::string, Result>;
+
+const std::vector<Scenario>& scenarios() {
+  static const std::vector<Scenario> kScenarios = {
+    /** Few neighbours per boid, dominated by per boid cost and grid overhead */
+    {"sparse", 5000, Vector2u(16000, 12000), Vector2f(0, 0), Vector2f(16000, 12000), 0},
+    /** Hundreds of neighbours per boid, dominated by the neighbour pass */
+    {"dense_cluster", 2000, Vector2u(4000, 4000), Vector2f(1400, 1400), Vector2f(2600, 2600), 0},
+    /** Many boids escaping at once from predators moving through the flock */
+    {"predator_storm", 5000, Vector2u(4000, 3000), Vector2f(0, 0), Vector2f(4000, 3000), 48},
+  };
+  return kScenarios;
+}
+
+Predators storm_predators(const Scenario& scenario, unsigned int tick) {
+  Predators predators(scenario.predator_count);
+  const unsigned int kColumns = static_cast<unsigned int>(std::ceil(std::sqrt(scenario.predator_count)));
+  const float kSpacingX = static_cast<float>(scenario.world_size.x) / kColumns;
+  const float kSpacingY = static_cast<float>(scenario.world_size.y) / kColumns;
+  const float kAngle = tick * kDt;
+  for (unsigned int i = 0; i < scenario.predator_count; ++i) {
+    const Vector2f kCenter((i % kColumns + 0.5f) * kSpacingX, (i / kColumns + 0.5f) * kSpacingY);
+    predators[i].position = Vector2s(kCenter + Vector2f(std::cos(kAngle), std::sin(kAngle)) * (kSpacingX / 3));
+  }
+  return predators;
+}
+
+Result run(const Scenario& scenario, unsigned int ticks) {
+  RandomGenerator random = make_random_generator(1);
+  Boids spawned(scenario.boid_count);
+  randomize_boids(spawned, scenario.world_size, random);
+  Boids boids;
+  const Vector2f kSpawnSize = scenario.spawn_max - scenario.spawn_min;
+  for (const Boid& kBoid : spawned) {
+    const Vector2s kPosition(scenario.spawn_min.x + kBoid.position().x * kSpawnSize.x / scenario.world_size.x,
+                             scenario.spawn_min.y + kBoid.position().y * kSpawnSize.y / scenario.world_size.y);
+    boids.push_back(Boid(kPosition, kBoid.rotation()));
+  }
+
+  ThreadPool thread_pool(1);
+  SpatialGrid grid;
+  unsigned int tick = 0;
+  for (; tick < kWarmupTicks; ++tick) {
+    update_boids(boids, grid, storm_predators(scenario, tick), kDt, scenario.world_size, thread_pool);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  std::vector<double> tick_ms;
+  tick_ms.reserve(ticks);
+  const AllocationCounts kAllocationsBefore = allocation_counts(AllocationPhase::kSimulation);
+  for (unsigned int i = 0; i < ticks; ++i, ++tick) {
+    const Predators kPredators = storm_predators(scenario, tick);
+    const Clock::time_point kStart = Clock::now();
+    {
+      AllocationScope allocation_scope(AllocationPhase::kSimulation);
+      update_boids(boids, grid, kPredators, kDt, scenario.world_size, thread_pool);
+    }
+    const Clock::time_point kEnd = Clock::now();
+    tick_ms.push_back(Milliseconds(kEnd - kStart).count());
+  }
+  const unsigned long kAllocations =
+    allocation_counts(AllocationPhase::kSimulation).allocations - kAllocationsBefore.allocations;
+
+  /** Median, a few ticks preempted by other processes don't move it */
+  std::nth_element(tick_ms.begin(), tick_ms.begin() + tick_ms.size() / 2, tick_ms.end());
+  const double kMedianMs = tick_ms[tick_ms.size() / 2];
+  Result result;
+  result.ticks_per_second = kMedianMs > 0 ? 1000 / kMedianMs : 0;
+  result.allocations_per_tick = static_cast<double>(kAllocations) / ticks;
+  return result;
+}
+
+/** Parse baselines file, INI format with one section per scenario */
+Baselines load_baselines(const std::string& path) {
+  Baselines baselines;
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot open baselines file " + path);
+  }
+
+  std::string section;
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return std::isspace(c); }), line.end());
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line.front() == '[' && line.back() == ']') {
+      section = line.substr(1, line.size() - 2);
+      continue;
+    }
+
+    const auto kSeparator = line.find('=');
+    if (section.empty() || kSeparator == std::string::npos) {
+      throw std::runtime_error(path + ": expected [scenario] followed by key = value lines");
+    }
+
+    const std::string kKey = line.substr(0, kSeparator);
+    const double kValue = std::stod(line.substr(kSeparator + 1));
+    if (kKey == "ticks_per_second") {
+      baselines[section].ticks_per_second = kValue;
+    } else if (kKey == "allocations_per_tick") {
+      baselines[section].allocations_per_tick = kValue;
+    } else {
+      throw std::runtime_error(path + ": unknown key \"" + kKey + "\"");
+    }
+  }
+  return baselines;
+}
+
+void save_baselines(const std::string& path, const std::map<std::string, Result>& results) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Cannot write baselines file " + path);
+  }
+
+  file << "# Baselines of boids_perf_test, regenerate with boids_perf_test --update-baselines on the gating machine\n";
+  for (const auto& kResult : results) {
+    file << "\n[" << kResult.first << "]\n"
+         << "ticks_per_second = " << kResult.second.ticks_per_second << "\n"
+         << "allocations_per_tick = " << kResult.second.allocations_per_tick << "\n";
+  }
+}
+
+}  // namespace
+
+/**
+ * Performance regression gate of update_boids, run by CTest when configured with -DBOIDS_PERF_TESTS=ON.
+ *
+ * Runs fixed seed scenarios, compares median ticks per second and allocations per tick against stored baselines
+ * and fails if any of them regressed beyond the tolerance.
+ *
+ * Arguments:
+ *   --baselines=<path>   Baselines file (INI, one section per scenario).
+ *   --report=<path>      Write JSON report for trend tracking.
+ *   --tolerance=<f>      Allowed ticks per second drop as a fraction of the baseline, default 0.25.
+ *   --ticks=<n>          Measured ticks per scenario.
+ *   --update-baselines   Write measured values to the baselines file instead of comparing.
+ */
+int main(int argc, char* argv[]) {
+  std::string baselines_path;
+  std::string report_path;
+  double tolerance = kDefaultTolerance;
+  unsigned int ticks = kDefaultTicks;
+  bool update_baselines = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string kArgument = argv[i];
+    if (kArgument.compare(0, 12, "--baselines=") == 0) {
+      baselines_path = kArgument.substr(12);
+    } else if (kArgument.compare(0, 9, "--report=") == 0) {
+      report_path = kArgument.substr(9);
+    } else if (kArgument.compare(0, 12, "--tolerance=") == 0) {
+      tolerance = std::stod(kArgument.substr(12));
+    } else if (kArgument.compare(0, 8, "--ticks=") == 0) {
+      ticks = std::stoul(kArgument.substr(8));
+    } else if (kArgument == "--update-baselines") {
+      update_baselines = true;
+    } else {
+      std::cerr << "Unexpected argument \"" << kArgument << "\"\n";
+      return 2;
+    }
+  }
+
+  if (baselines_path.empty()) {
+    std::cerr << "--baselines=<path> is required\n";
+    return 2;
+  }
+
+  const Baselines kBaselines = update_baselines ? Baselines() : load_baselines(baselines_path);
+  std::map<std::string, Result> results;
+  bool passed = true;
+  std::string report = "{\n  \"timestamp\": " + std::to_string(std::time(nullptr)) +
+                       ",\n  \"tolerance\": " + std::to_string(tolerance) + ",\n  \"scenarios\": [\n";
+  for (std::size_t i = 0; i < scenarios().size(); ++i) {
+    const Scenario& kScenario = scenarios()[i];
+    const Result kResult = run(kScenario, ticks);
+    results[kScenario.name] = kResult;
+
+    const auto kBaseline = kBaselines.find(kScenario.name);
+    const bool kHasBaseline = kBaseline != kBaselines.end();
+    const bool kSpeedPassed = !kHasBaseline ||
+      kResult.ticks_per_second >= kBaseline->second.ticks_per_second * (1 - tolerance);
+    const bool kAllocationsPassed = !kHasBaseline ||
+      kResult.allocations_per_tick <= kBaseline->second.allocations_per_tick * (1 + kAllocationTolerance) + 1;
+    passed = passed && kSpeedPassed && kAllocationsPassed;
+
+    std::cout << kScenario.name << ": " << kResult.ticks_per_second << " ticks/s, "
+              << kResult.allocations_per_tick << " allocations/tick";
+    if (kHasBaseline) {
+      std::cout << " (baseline " << kBaseline->second.ticks_per_second << " ticks/s, "
+                << kBaseline->second.allocations_per_tick << " allocations/tick)"
+                << (kSpeedPassed ? "" : " SLOWER") << (kAllocationsPassed ? "" : " MORE ALLOCATIONS");
+    }
+    std::cout << "\n";
+
+    report += "    {\"name\": \"" + kScenario.name + "\"" +
+              ", \"boids\": " + std::to_string(kScenario.boid_count) +
+              ", \"ticks\": " + std::to_string(ticks) +
+              ", \"ticks_per_second\": " + std::to_string(kResult.ticks_per_second) +
+              ", \"allocations_per_tick\": " + std::to_string(kResult.allocations_per_tick);
+    if (kHasBaseline) {
+      report += ", \"baseline_ticks_per_second\": " + std::to_string(kBaseline->second.ticks_per_second) +
+                ", \"baseline_allocations_per_tick\": " + std::to_string(kBaseline->second.allocations_per_tick);
+    }
+    report += std::string(", \"passed\": ") + (kSpeedPassed && kAllocationsPassed ? "true" : "false") + "}" +
+              (i + 1 < scenarios().size() ? "," : "") + "\n";
+  }
+  report += std::string("  ],\n  \"passed\": ") + (passed ? "true" : "false") + "\n}\n";
+
+  if (!report_path.empty()) {
+    std::ofstream report_file(report_path);
+    if (!report_file) {
+      std::cerr << "Cannot write report " << report_path << "\n";
+      return 2;
+    }
+    report_file << report;
+  }
+
+  if (update_baselines) {
+    save_baselines(baselines_path, results);
+    std::cout << "Baselines written to " << baselines_path << "\n";
+    return 0;
+  }
+
+  return passed ? 0 : 1;
+}
@@ -1,9 +1,10 @@
 #pragma once
 
-#include <SFML/System.hpp>
+#include <vector>
+#include "scalar.h"
 
 struct Predator {
-  sf::Vector2f position;
+  Vector2s position;
   int size = 20;
 };
 
@@ -0,0 +1,18 @@
+#include "rate_counter.h"
+
+constexpr float RateCounter::kPeriodSeconds;
+
+void RateCounter::tick() {
+  ++count_;
+  const auto kNow = std::chrono::steady_clock::now();
+  const float kElapsed = std::chrono::duration<float>(kNow - period_start_).count();
+  if (kElapsed >= kPeriodSeconds) {
+    rate_ = count_ / kElapsed;
+    count_ = 0;
+    period_start_ = kNow;
+  }
+}
+
+float RateCounter::rate() const {
+  return rate_;
+}
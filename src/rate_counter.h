@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+
+/**
+ * Counts events (frames, simulation ticks) and reports their rate, averaged over about one second.
+ */
+class RateCounter {
+ public:
+  /** Count one event */
+  void tick();
+
+  /** Events per second measured over the last complete period */
+  float rate() const;
+ private:
+  static constexpr float kPeriodSeconds = 1;
+
+  std::chrono::steady_clock::time_point period_start_ = std::chrono::steady_clock::now();
+  unsigned int count_ = 0;
+  float rate_ = 0;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "vector2.h"
+
+/**
+ * Floating point type of the simulation core, picked at configure time with -DBOIDS_SCALAR=float|double.
+ *
+ * Float is faster and is what the renderer uses, double keeps positions exact enough in very large worlds and
+ * long runs. Tuning values (Boid::Config) and time steps stay float either way.
+ */
+#if defined(BOIDS_SCALAR_DOUBLE)
+using Scalar = double;
+constexpr const char* kScalarName = "double";
+#else
+using Scalar = float;
+constexpr const char* kScalarName = "float";
+#endif
+
+using Vector2s = Vector2<Scalar>;
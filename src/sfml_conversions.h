@@ -0,0 +1,26 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "color.h"
+#include "vector2.h"
+
+/** Conversions between simulation core types and SFML types, only used by the renderer */
+
+template<class T>
+sf::Vector2<T> to_sfml(const Vector2<T>& vector) {
+  return sf::Vector2<T>(vector.x, vector.y);
+}
+
+/** SFML renders in float, double precision simulation positions are narrowed */
+inline sf::Vector2f to_sfml(const Vector2<double>& vector) {
+  return sf::Vector2f(vector.x, vector.y);
+}
+
+template<class T>
+Vector2<T> from_sfml(const sf::Vector2<T>& vector) {
+  return Vector2<T>(vector.x, vector.y);
+}
+
+inline sf::Color to_sfml(const Color& color) {
+  return sf::Color(color.r, color.g, color.b, color.a);
+}
@@ -0,0 +1,509 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "frame_arena.h"
+
+constexpr unsigned int Simulation::kMaxFixedStepsPerTick;
+constexpr std::size_t Simulation::kCommandQueueCapacity;
+
+namespace {
+
+/** Grid cells per cohesion distance (in each axis) in topological mode */
+constexpr float kTopologicalGridSubdivision = 4;
+/** Open world, the grid may have this many cells per boid before its cells grow beyond the query radius */
+constexpr Scalar kOpenGridCellsPerBoid = 4;
+
+/** Morton code and index of every boid */
+using SortKeys = ArenaVector<std::pair<std::uint32_t, unsigned int>>;
+
+Boid random_boid(const Vector2u& world_size, RandomGenerator& gen) {
+  std::uniform_int_distribution<> random_rotation(0, 359);
+  std::uniform_int_distribution<> random_pos_x(0, world_size.x);
+  std::uniform_int_distribution<> random_pos_y(0, world_size.y);
+
+  return Boid(Vector2s(random_pos_x(gen), random_pos_y(gen)), random_rotation(gen));
+}
+
+BoidAppearance random_appearance(RandomGenerator& gen) {
+  std::uniform_int_distribution<> random_color_channel_value(50, 255);
+
+  BoidAppearance appearance;
+  appearance.color = Color(random_color_channel_value(gen),
+                           random_color_channel_value(gen),
+                           random_color_channel_value(gen));
+  return appearance;
+}
+
+/** Boid indices sorted along a Z-order curve of their positions */
+SortKeys spatial_order(const Boids& boids, const Vector2u& world_size) {
+  SortKeys keys(boids.size());
+  const float kScaleX = 0xffff / std::max(1.0f, static_cast<float>(world_size.x));
+  const float kScaleY = 0xffff / std::max(1.0f, static_cast<float>(world_size.y));
+  for (std::size_t i = 0; i < boids.size(); ++i) {
+    /** Keys are 16 bit per axis, float is plenty */
+    const Vector2f kPosition(boids[i].position());
+    const auto kX = static_cast<std::uint32_t>(std::min(std::max(kPosition.x * kScaleX, 0.0f), 65535.0f));
+    const auto kY = static_cast<std::uint32_t>(std::min(std::max(kPosition.y * kScaleY, 0.0f), 65535.0f));
+    keys[i] = SortKeys::value_type(morton_code_2d(kX, kY), i);
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+/** Reorder items by the indices in keys, the scratch storage keeps its capacity as it is swapped in and out */
+template<class T>
+void apply_order(std::vector<T>& items, const SortKeys& keys) {
+  static thread_local std::vector<T> ordered;
+  ordered.clear();
+  for (const auto& kKey : keys) {
+    ordered.push_back(items[kKey.second]);
+  }
+  items.swap(ordered);
+}
+
+}  // namespace
+
+RandomGenerator make_random_generator(unsigned int seed) {
+  if (seed == 0) {
+    std::random_device rd;
+    seed = rd();
+  }
+  return RandomGenerator(seed);
+}
+
+void randomize_boids(Boids& boids, const Vector2u& world_size, RandomGenerator& random) {
+  for (auto& boid : boids) {
+    boid = random_boid(world_size, random);
+  }
+}
+
+void randomize_boids(Boids& boids, BoidAppearances& appearances, const Vector2u& world_size, RandomGenerator& random) {
+  appearances.resize(boids.size());
+  for (std::size_t i = 0; i < boids.size(); ++i) {
+    boids[i] = random_boid(world_size, random);
+    appearances[i] = random_appearance(random);
+  }
+}
+
+void add_boids(Boids& boids,
+               BoidAppearances& appearances,
+               unsigned int count,
+               const Vector2u& world_size,
+               RandomGenerator& random) {
+  boids.reserve(boids.size() + count);
+  appearances.reserve(appearances.size() + count);
+  for (unsigned int i = 0; i < count; ++i) {
+    boids.push_back(random_boid(world_size, random));
+    appearances.push_back(random_appearance(random));
+  }
+}
+
+void remove_boids(Boids& boids, BoidAppearances& appearances, unsigned int count) {
+  if (boids.size() > 1) {
+    const Boids::size_type kNumberOfBoidsToRemove = std::min(boids.size(), static_cast<Boids::size_type>(count));
+
+    /** Erase keeps the capacity, removing boids never allocates */
+    boids.erase(boids.begin(), boids.begin() + kNumberOfBoidsToRemove);
+    appearances.erase(appearances.begin(), appearances.begin() + kNumberOfBoidsToRemove);
+  }
+}
+
+Obstacles load_obstacle_field(const AppConfig& config,
+                              const Vector2u& world_size,
+                              ThreadPool& thread_pool,
+                              ObstacleField& field) {
+  const Obstacles kObstacles = config.obstacles_file.empty() ? Obstacles() : load_obstacles(config.obstacles_file);
+  field.bake(kObstacles, world_size, config.obstacle_cell_size, thread_pool);
+  return kObstacles;
+}
+
+void reset_flow_field(const AppConfig& config,
+                      const Vector2u& world_size,
+                      const ObstacleField& obstacle_field,
+                      ThreadPool& thread_pool,
+                      FlowField& field) {
+  field.reset(world_size,
+              config.goal_cell_size,
+              config.boid.boundary == BoundaryMode::kWrap,
+              &obstacle_field,
+              thread_pool);
+  field.update(config.goals, thread_pool);
+}
+
+void update_grid(SpatialGrid& grid, const Boids& boids, const Vector2u& world_size) {
+  /** Cohesion is the largest neighbour radius, so any query only touches the neighbouring cells */
+  const float kCohesionDistance = Boid::config().size * Boid::config().cohesion_distance_factor;
+  /** Nearest neighbour search stops early, finer cells let it skip most of a dense cluster */
+  const float kCellSize =
+    Boid::config().topological_neighbours > 0 ? kCohesionDistance / kTopologicalGridSubdivision : kCohesionDistance;
+  if (Boid::config().boundary != BoundaryMode::kOpen) {
+    grid.update(boids, Vector2s(), world_size, kCellSize);
+    return;
+  }
+
+  /** Open world, the grid covers the world and wherever the flock went */
+  Vector2s min;
+  Vector2s max(world_size.x, world_size.y);
+  for (const Boid& kBoid : boids) {
+    min = Vector2s(std::min(min.x, kBoid.position().x), std::min(min.y, kBoid.position().y));
+    max = Vector2s(std::max(max.x, kBoid.position().x), std::max(max.y, kBoid.position().y));
+  }
+
+  const Vector2s kGridMin = grid.origin();
+  const Vector2s kGridMax = grid.origin() + Vector2s(grid.size().x, grid.size().y);
+  const Scalar kArea = (max.x - min.x) * (max.y - min.y);
+  const Scalar kGridArea = (kGridMax.x - kGridMin.x) * (kGridMax.y - kGridMin.y);
+  /** Same area unless the flock left it or it is way too large for the flock, the grid is only moved by rebuilds */
+  if (min.x >= kGridMin.x && min.y >= kGridMin.y && max.x <= kGridMax.x && max.y <= kGridMax.y &&
+      kGridArea <= 16 * kArea && grid.cell_size() >= kCellSize) {
+    grid.update(boids, kGridMin, grid.size(), grid.cell_size());
+    return;
+  }
+
+  /** Grown ahead of the flock, so boids spreading out don't rebuild it every tick */
+  const Vector2s kMargin = (max - min) / Scalar(4) + Vector2s(kCellSize, kCellSize);
+  min -= kMargin;
+  max += kMargin;
+  /** Cells grow with a scattered flock instead of their count, larger cells only cost more candidates per query */
+  const Scalar kMaxCells = std::max(kOpenGridCellsPerBoid * boids.size(),
+                                    (Scalar(world_size.x) / kCellSize) * (Scalar(world_size.y) / kCellSize));
+  const Scalar kGrownCellSize =
+    std::max<Scalar>(kCellSize, std::sqrt((max.x - min.x) * (max.y - min.y) / kMaxCells));
+  /**
+   * New geometry is not a steady state even if the flock size didn't change, more cells than before need more
+   * storage. Allowed here so callers forbidding allocations per tick don't have to predict the rebuild.
+   */
+  const AllocationScope kRebuildScope(AllocationScope::current_phase());
+  grid.update(boids,
+              Vector2s(std::floor(min.x), std::floor(min.y)),
+              Vector2u(static_cast<unsigned int>(std::ceil(max.x - min.x)),
+                       static_cast<unsigned int>(std::ceil(max.y - min.y))),
+              kGrownCellSize);
+}
+
+void toggle_boid_selection(const Boids& boids,
+                           BoidAppearances& appearances,
+                           const SpatialGrid& grid,
+                           const Vector2s& position) {
+  const Scalar kPickDistance = 2 * Boid::config().size;
+  BoidAppearance* closest_boid = nullptr;
+  Scalar closest_distance = kPickDistance;
+  grid.for_each_in_radius(position, kPickDistance, [&](unsigned int index) {
+    const Scalar kDistance = distance_2d(position, boids[index].position());
+    if (kDistance < closest_distance) {
+      closest_distance = kDistance;
+      closest_boid = &appearances[index];
+    }
+  });
+
+  if (closest_boid) {
+    closest_boid->debug_selected = !closest_boid->debug_selected;
+  }
+}
+
+void sort_boids_spatially(Boids& boids, const Vector2u& world_size) {
+  apply_order(boids, spatial_order(boids, world_size));
+}
+
+void sort_boids_spatially(Boids& boids, BoidAppearances& appearances, const Vector2u& world_size) {
+  /** Keys are only needed during the sort, they live in the frame arena */
+  const SortKeys kKeys = spatial_order(boids, world_size);
+  apply_order(boids, kKeys);
+  apply_order(appearances, kKeys);
+}
+
+void update_boids(Boids& boids,
+                  SpatialGrid& grid,
+                  const Predators& predators,
+                  float dt,
+                  const Vector2u& world_size,
+                  ThreadPool& thread_pool,
+                  UpdateMetrics* metrics,
+                  std::vector<unsigned int>* neighbour_counts) {
+  update_boids(boids, Boids(), grid, predators, dt, world_size, thread_pool, metrics, neighbour_counts);
+}
+
+void update_boids(Boids& boids,
+                  const Boids& halo,
+                  SpatialGrid& grid,
+                  const Predators& predators,
+                  float dt,
+                  const Vector2u& world_size,
+                  ThreadPool& thread_pool,
+                  UpdateMetrics* metrics,
+                  std::vector<unsigned int>* neighbour_counts) {
+  /**
+   * Every boid sees the flock as it was at the start of the step, so chunks can be updated in parallel. Kept between
+   * calls, so the copy only allocates when the number of boids grows. Captured through a reference, inside the
+   * chunks the thread local name would refer to the copy of the pool thread.
+   */
+  static thread_local Boids previous_boids_storage;
+  static thread_local PackedBoids packed_boids_storage;
+  Boids& previous_boids = previous_boids_storage;
+  PackedBoids& packed_boids = packed_boids_storage;
+  const bool kQuantized = Boid::config().quantized_neighbours;
+  /** Packed mode only needs whole boids in one container to index the grid, without halo boids are enough */
+  const Boids* flock = &boids;
+  if (!kQuantized || !halo.empty()) {
+    previous_boids.clear();
+    previous_boids.insert(previous_boids.end(), boids.begin(), boids.end());
+    previous_boids.insert(previous_boids.end(), halo.begin(), halo.end());
+    flock = &previous_boids;
+  }
+  update_grid(grid, *flock, world_size);
+  if (kQuantized) {
+    packed_boids.pack(*flock, grid);
+  }
+  if (neighbour_counts) {
+    neighbour_counts->resize(boids.size());
+  }
+
+  std::mutex metrics_mutex;
+  /** Boundary policy is picked once per step, the loops below are compiled once per policy */
+  with_boundary(Boid::config().boundary, [&](auto boundary) {
+    using Boundary = decltype(boundary);
+    thread_pool.parallel_for(boids.size(), [&](std::size_t begin, std::size_t end) {
+      /** Chunks count on their own and merge once at the end */
+      UpdateMetrics chunk_metrics;
+      UpdateMetrics* const kChunkMetrics = metrics ? &chunk_metrics : nullptr;
+      unsigned int* const kNeighbourCounts = neighbour_counts ? neighbour_counts->data() : nullptr;
+      if (kQuantized) {
+        for (std::size_t i = begin; i < end; ++i) {
+          const unsigned int kCount =
+            boids[i].template update<Boundary>(packed_boids, grid, predators, dt, world_size, kChunkMetrics);
+          if (kNeighbourCounts) {
+            kNeighbourCounts[i] = kCount;
+          }
+        }
+      } else {
+        for (std::size_t i = begin; i < end; ++i) {
+          const unsigned int kCount =
+            boids[i].template update<Boundary>(previous_boids, grid, predators, dt, world_size, kChunkMetrics);
+          if (kNeighbourCounts) {
+            kNeighbourCounts[i] = kCount;
+          }
+        }
+      }
+
+      if (metrics) {
+        std::lock_guard<std::mutex> lock(metrics_mutex);
+        *metrics += chunk_metrics;
+      }
+    });
+  });
+}
+
+Simulation::Simulation(const AppConfig& config, const Vector2u& world_size)
+  : config_(config),
+    world_size_(world_size),
+    thread_pool_(config.threads),
+    random_(make_random_generator(config.seed)),
+    boids_(config.startup_boid_count),
+    /** Mouse predator starts outside of the world until the mouse moves */
+    mouse_predator_position_(Vector2f(-1e6f, -1e6f)),
+    obstacles_(load_obstacle_field(config, world_size, thread_pool_, obstacle_field_)),
+    goals_(config.goals) {
+  randomize_boids(boids_, appearances_, world_size_, random_);
+  Boid::set_obstacle_field(&obstacle_field_);
+  reset_flow_field(config_, world_size_, obstacle_field_, thread_pool_, flow_field_);
+  Boid::set_flow_field(&flow_field_);
+}
+
+Simulation::~Simulation() {
+  stop();
+  Boid::set_obstacle_field(nullptr);
+  Boid::set_flow_field(nullptr);
+}
+
+void Simulation::start() {
+  if (!running_.exchange(true)) {
+    thread_ = std::thread([this] { run(); });
+  }
+}
+
+void Simulation::stop() {
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool Simulation::push_command(const SimulationCommand& command) {
+  return commands_.push(command);
+}
+
+void Simulation::set_predator_position(const Vector2f& position) {
+  mouse_predator_position_.store(position, std::memory_order_relaxed);
+}
+
+const Obstacles& Simulation::obstacles() const {
+  return obstacles_;
+}
+
+const FrameSnapshot& Simulation::latest_frame() {
+  frames_.update();
+  return frames_.read_buffer();
+}
+
+void Simulation::run() {
+  using Clock = std::chrono::steady_clock;
+  using Seconds = std::chrono::duration<float>;
+  /** Everything the simulation thread allocates counts as simulation */
+  AllocationScope allocation_scope(AllocationPhase::kSimulation);
+  Clock::time_point last_tick = Clock::now();
+  float fixed_step_accumulator = 0;
+  RateCounter tick_rate;
+  while (running_) {
+    handle_commands();
+
+    Predator mouse_predator;
+    mouse_predator.position = Vector2s(mouse_predator_position_.load(std::memory_order_relaxed));
+    predators_.clear();
+    predators_.push_back(mouse_predator);
+
+    const Clock::time_point kNow = Clock::now();
+    const float kDt = Seconds(kNow - last_tick).count();
+    last_tick = kNow;
+    if (config_.timestep > 0) {
+      const float kTimestep = config_.timestep;
+      fixed_step_accumulator += kDt;
+      if (fixed_step_accumulator < kTimestep) {
+        /** Ahead of schedule, nothing to publish yet */
+        std::this_thread::sleep_for(Seconds(kTimestep - fixed_step_accumulator));
+        continue;
+      }
+
+      unsigned int steps = 0;
+      while (fixed_step_accumulator >= kTimestep && steps < kMaxFixedStepsPerTick) {
+        step(kTimestep);
+        fixed_step_accumulator -= kTimestep;
+        ++steps;
+      }
+      /** Drop the backlog if the simulation can't keep up */
+      if (steps == kMaxFixedStepsPerTick) {
+        fixed_step_accumulator = 0;
+      }
+    } else {
+      step(kDt);
+    }
+
+    tick_rate.tick();
+    publish_frame(tick_rate.rate());
+  }
+}
+
+void Simulation::step(float dt) {
+  /** Everything allocated from the arena during the previous tick is gone by now */
+  FrameArena& arena = FrameArena::for_current_thread();
+  arena.reset();
+
+  if (config_.morton_sort_interval > 0 && tick_ % config_.morton_sort_interval == 0) {
+    sort_boids_spatially(boids_, appearances_, world_size_);
+  }
+
+  /** Only recomputed in the tick after goals changed */
+  flow_field_.update(goals_, thread_pool_);
+  Boid::set_flow_field(&flow_field_);
+
+  const bool kGatherMetrics = !config_.metrics_file.empty();
+  UpdateMetrics metrics;
+  {
+    /**
+     * Scratch buffers and grid only grow when the number of boids changes, otherwise the update is heap free. An open
+     * world grid moving with the flock is the exception, update_grid allows its rebuilds itself.
+     */
+    const bool kSteadyState = boids_.size() == previous_step_boid_count_;
+    previous_step_boid_count_ = boids_.size();
+    AllocationScope allocation_scope(AllocationPhase::kSimulation, kSteadyState);
+    update_boids(boids_, grid_, predators_, dt, world_size_, thread_pool_, kGatherMetrics ? &metrics : nullptr);
+  }
+  arena_peak_bytes_ = arena.peak();
+  ++tick_;
+
+  if (!kGatherMetrics) {
+    return;
+  }
+
+  metrics_totals_ += metrics;
+  if (config_.metrics_interval > 0 && tick_ % config_.metrics_interval == 0) {
+    try {
+      write_prometheus_metrics(config_.metrics_file,
+                               tick_,
+                               metrics_totals_,
+                               metrics,
+                               grid_occupancy(grid_));
+    } catch (const std::runtime_error& error) {
+      /** Metrics are not worth stopping the simulation for */
+      std::cerr << error.what() << std::endl;
+    }
+  }
+}
+
+void Simulation::handle_commands() {
+  SimulationCommand command;
+  while (commands_.pop(command)) {
+    switch (command.type) {
+      case SimulationCommand::Type::kRandomize: {
+        randomize_boids(boids_, appearances_, world_size_, random_);
+        break;
+      }
+      case SimulationCommand::Type::kAddBoids: {
+        add_boids(boids_, appearances_, config_.add_remove_boids_count, world_size_, random_);
+        break;
+      }
+      case SimulationCommand::Type::kRemoveBoids: {
+        remove_boids(boids_, appearances_, config_.add_remove_boids_count);
+        break;
+      }
+      case SimulationCommand::Type::kToggleSelection: {
+        /** Boids may have been added or removed since the last step */
+        update_grid(grid_, boids_, world_size_);
+        toggle_boid_selection(boids_, appearances_, grid_, Vector2s(command.position));
+        break;
+      }
+      case SimulationCommand::Type::kToggleGoal: {
+        const Vector2s kPosition(command.position);
+        const auto kClose = std::find_if(goals_.begin(), goals_.end(), [&](const Vector2s& goal) {
+          return length(goal - kPosition) < config_.goal_cell_size;
+        });
+        if (kClose != goals_.end()) {
+          goals_.erase(kClose);
+        } else {
+          goals_.push_back(kPosition);
+        }
+        break;
+      }
+    }
+  }
+}
+
+void Simulation::publish_frame(float tick_rate) {
+  FrameSnapshot& frame = frames_.write_buffer();
+  frame.tick_rate = tick_rate;
+  /** Assignment reuses storage left in the buffer from earlier frames */
+  frame.boids = boids_;
+  frame.appearances = appearances_;
+  frame.predators = predators_;
+  frame.goals = goals_;
+  /**
+   * Grid is used by the renderer for culling and density splats, so it has to match positions after the update. Same
+   * geometry as the simulation grid, which follows the flock out of an open world.
+   */
+  frame.grid.update(frame.boids, grid_.origin(), grid_.size(), grid_.cell_size());
+  frame.grid_reinsertions = grid_.reinsertions();
+  const AllocationCounts kAllocations = allocation_counts(AllocationPhase::kSimulation);
+  const unsigned long kTicks = std::max(1ul, tick_ - published_tick_);
+  frame.allocations_per_tick.allocations = (kAllocations.allocations - published_allocations_.allocations) / kTicks;
+  frame.allocations_per_tick.bytes = (kAllocations.bytes - published_allocations_.bytes) / kTicks;
+  published_allocations_ = kAllocations;
+  published_tick_ = tick_;
+  frame.arena_peak_bytes = arena_peak_bytes_;
+  frames_.publish();
+}
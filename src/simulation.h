@@ -0,0 +1,310 @@
+#pragma once
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include "allocation_tracker.h"
+#include "boid.h"
+#include "config.h"
+#include "metrics.h"
+#include "predator.h"
+#include "rate_counter.h"
+#include "spatial_grid.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+#include "triple_buffer.h"
+
+using RandomGenerator = std::mt19937;
+
+/**
+ * Create random generator.
+ *
+ * \param seed Seed, 0 means random seed.
+ * \return Random generator.
+ */
+RandomGenerator make_random_generator(unsigned int seed);
+
+/**
+ * Randomize boids positions and rotations.
+ *
+ * \param boids Boids.
+ * \param world_size World size.
+ * \param random Random generator.
+ */
+void randomize_boids(Boids& boids, const Vector2u& world_size, RandomGenerator& random);
+
+/**
+ * Randomize boids positions, rotations and colors.
+ *
+ * \param boids Boids.
+ * \param appearances Appearances, resized to match boids.
+ * \param world_size World size.
+ * \param random Random generator.
+ */
+void randomize_boids(Boids& boids, BoidAppearances& appearances, const Vector2u& world_size, RandomGenerator& random);
+
+/**
+ * Add randomized boids.
+ *
+ * \param boids Boids.
+ * \param appearances Appearances of boids.
+ * \param count Number of boids to add.
+ * \param world_size World size.
+ * \param random Random generator.
+ */
+void add_boids(Boids& boids,
+               BoidAppearances& appearances,
+               unsigned int count,
+               const Vector2u& world_size,
+               RandomGenerator& random);
+
+/**
+ * Remove boids, at least one boid is always kept.
+ *
+ * \param boids Boids.
+ * \param appearances Appearances of boids.
+ * \param count Number of boids to remove.
+ */
+void remove_boids(Boids& boids, BoidAppearances& appearances, unsigned int count);
+
+/**
+ * Load obstacles file of the config and bake it into an obstacle field, boids only avoid it once it is passed to
+ * Boid::set_obstacle_field.
+ *
+ * \param config Config, no config.obstacles_file means no obstacles.
+ * \param world_size World size.
+ * \param thread_pool Thread pool the baking is split across.
+ * \param field Field to bake, left empty without obstacles.
+ * \return Obstacles, e.g. for drawing.
+ */
+Obstacles load_obstacle_field(const AppConfig& config,
+                              const Vector2u& world_size,
+                              ThreadPool& thread_pool,
+                              ObstacleField& field);
+
+/**
+ * Lay the flow field out over the world and point it to the goals of the config, boids only steer by it once it is
+ * passed to Boid::set_flow_field.
+ *
+ * \param config Config, no config.goals means the field stays empty until FlowField::update gets some.
+ * \param world_size World size.
+ * \param obstacle_field Baked obstacles, paths lead around them.
+ * \param thread_pool Thread pool the field is computed on.
+ * \param field Field to reset.
+ */
+void reset_flow_field(const AppConfig& config,
+                      const Vector2u& world_size,
+                      const ObstacleField& obstacle_field,
+                      ThreadPool& thread_pool,
+                      FlowField& field);
+
+/**
+ * Update (incrementally) spatial grid used for neighbour search, cell size matches the largest neighbour radius
+ * (or a fraction of it in topological mode).
+ *
+ * The grid covers the world, in an open world (BoundaryMode::kOpen) also the boids outside of it. It is then
+ * rebuilt larger whenever the flock leaves it, with larger cells once a scattered flock would need too many.
+ *
+ * \param grid Grid.
+ * \param boids Boids.
+ * \param world_size World size.
+ */
+void update_grid(SpatialGrid& grid, const Boids& boids, const Vector2u& world_size);
+
+/**
+ * Toggle debug selection of the boid closest to given position.
+ *
+ * \param boids Boids.
+ * \param appearances Appearances of boids, the selection flag is stored there.
+ * \param grid Spatial grid built from boids.
+ * \param position Position in world coordinates.
+ */
+void toggle_boid_selection(const Boids& boids,
+                           BoidAppearances& appearances,
+                           const SpatialGrid& grid,
+                           const Vector2s& position);
+
+/**
+ * Reorder boids storage along a Z-order curve of their positions, so boids close in the world are close in memory.
+ *
+ * Grids built from boids have to be updated afterwards, indices change. Sort keys come from the frame arena of the
+ * calling thread, which has to be reset once per tick.
+ *
+ * \param boids Boids.
+ * \param world_size World size.
+ */
+void sort_boids_spatially(Boids& boids, const Vector2u& world_size);
+
+/**
+ * Same as above, appearances are reordered along with boids.
+ *
+ * \param boids Boids.
+ * \param appearances Appearances of boids.
+ * \param world_size World size.
+ */
+void sort_boids_spatially(Boids& boids, BoidAppearances& appearances, const Vector2u& world_size);
+
+/**
+ * Perform one simulation step.
+ *
+ * \param boids Boids.
+ * \param grid Grid, brought up to date with boids before they are updated.
+ * \param predators Predators.
+ * \param dt Delta time in seconds.
+ * \param world_size World size.
+ * \param thread_pool Thread pool used to update boids in parallel.
+ * \param metrics Work counters to add to, nullptr means not measured.
+ * \param neighbour_counts Flockmates every boid steered by, by boid index, nullptr means not recorded.
+ */
+void update_boids(Boids& boids,
+                  SpatialGrid& grid,
+                  const Predators& predators,
+                  float dt,
+                  const Vector2u& world_size,
+                  ThreadPool& thread_pool,
+                  UpdateMetrics* metrics = nullptr,
+                  std::vector<unsigned int>* neighbour_counts = nullptr);
+
+/**
+ * Perform one simulation step of a part of the world.
+ *
+ * Halo boids are read-only copies of boids owned by other partitions, they are seen as flockmates but not
+ * updated.
+ *
+ * \param boids Boids owned by this partition.
+ * \param halo Boids owned by other partitions, close enough to influence boids above.
+ * \param grid Grid, brought up to date with boids followed by halo before boids are updated.
+ * \param predators Predators.
+ * \param dt Delta time in seconds.
+ * \param world_size World size.
+ * \param thread_pool Thread pool used to update boids in parallel.
+ * \param metrics Work counters to add to, nullptr means not measured.
+ * \param neighbour_counts Flockmates every boid steered by, by boid index, nullptr means not recorded.
+ */
+void update_boids(Boids& boids,
+                  const Boids& halo,
+                  SpatialGrid& grid,
+                  const Predators& predators,
+                  float dt,
+                  const Vector2u& world_size,
+                  ThreadPool& thread_pool,
+                  UpdateMetrics* metrics = nullptr,
+                  std::vector<unsigned int>* neighbour_counts = nullptr);
+
+/** Immutable (once published) simulation state handed over to the renderer */
+struct FrameSnapshot {
+  Boids boids;
+  /** Appearance of every boid above, same indices */
+  BoidAppearances appearances;
+  /** Grid matching positions of boids above */
+  SpatialGrid grid;
+  Predators predators;
+  Goals goals;
+  /** Simulation ticks per second */
+  float tick_rate = 0;
+  /** Boids which changed neighbour grid cell in the last tick */
+  unsigned int grid_reinsertions = 0;
+  /** Heap allocations of the simulation thread per tick since the previous frame, 0 unless tracking is linked in */
+  AllocationCounts allocations_per_tick;
+  /** Peak frame arena usage of the simulation thread in a single tick */
+  std::size_t arena_peak_bytes = 0;
+};
+
+/** Request sent from the render thread to the simulation thread */
+struct SimulationCommand {
+  enum class Type {
+    kRandomize,
+    kAddBoids,
+    kRemoveBoids,
+    kToggleSelection,
+    /** Add a goal, or remove the one close to position */
+    kToggleGoal,
+  };
+
+  Type type = Type::kRandomize;
+  /** Position in world coordinates, used by kToggleSelection and kToggleGoal */
+  Vector2f position;
+};
+
+/**
+ * Simulation running on its own thread.
+ *
+ * Input comes in through a lock-free command queue and every tick is published as a FrameSnapshot through
+ * a lock-free triple buffer, so neither the simulation nor the renderer ever waits for the other one.
+ */
+class Simulation {
+ public:
+  Simulation(const AppConfig& config, const Vector2u& world_size);
+  ~Simulation();
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  void start();
+  void stop();
+
+  /**
+   * Queue command for the simulation thread, never blocks.
+   *
+   * \param command Command.
+   * \return True if queued, false if the queue was full and command was dropped.
+   */
+  bool push_command(const SimulationCommand& command);
+
+  /**
+   * Move the mouse predator, never blocks. Only the latest position matters, so it bypasses the command queue.
+   *
+   * \param position Position in world coordinates.
+   */
+  void set_predator_position(const Vector2f& position);
+
+  /** Obstacles, fixed after construction so any thread may read them */
+  const Obstacles& obstacles() const;
+
+  /**
+   * Latest published frame, never blocks. Must only be called from the (single) render thread.
+   *
+   * \return Frame, valid until the next call.
+   */
+  const FrameSnapshot& latest_frame();
+ private:
+  /** Upper bound of fixed timestep updates per tick, avoids spiral of death when simulation can't keep up */
+  static constexpr unsigned int kMaxFixedStepsPerTick = 8;
+  static constexpr std::size_t kCommandQueueCapacity = 256;
+
+  void run();
+  void step(float dt);
+  void handle_commands();
+  void publish_frame(float tick_rate);
+
+  const AppConfig config_;
+  const Vector2u world_size_;
+  ThreadPool thread_pool_;
+  RandomGenerator random_;
+  Boids boids_;
+  /** Appearance of every boid, reordered, added and removed together with boids_ */
+  BoidAppearances appearances_;
+  SpatialGrid grid_;
+  unsigned long tick_ = 0;
+  /** Boids in the previous step, update_boids must not allocate while this doesn't change */
+  std::size_t previous_step_boid_count_ = 0;
+  AllocationCounts published_allocations_;
+  unsigned long published_tick_ = 0;
+  std::size_t arena_peak_bytes_ = 0;
+  /** Counters summed since start, only gathered when metrics are exported */
+  UpdateMetrics metrics_totals_;
+  /** Float whatever the scalar type is, so the atomic stays lock-free */
+  std::atomic<Vector2f> mouse_predator_position_;
+  Predators predators_;
+  /** Baked while obstacles_ is initialized, so declared first */
+  ObstacleField obstacle_field_;
+  Obstacles obstacles_;
+  /** Goals changed by commands, the flow field catches up at the start of the next step */
+  Goals goals_;
+  FlowField flow_field_;
+  SpscQueue<SimulationCommand, kCommandQueueCapacity> commands_;
+  TripleBuffer<FrameSnapshot> frames_;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
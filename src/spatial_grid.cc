@@ -0,0 +1,83 @@
+#include "spatial_grid.h"
+
+#include <cmath>
+#include "boid.h"
+
+constexpr int SpatialGrid::kNone;
+
+void SpatialGrid::rebuild(const Boids& boids, const Vector2s& origin, const Vector2u& size, Scalar cell_size) {
+  cell_size_ = cell_size;
+  origin_ = origin;
+  size_ = size;
+  columns_ = std::max(1, static_cast<int>(std::ceil(size.x / cell_size_)));
+  rows_ = std::max(1, static_cast<int>(std::ceil(size.y / cell_size_)));
+
+  cell_head_.assign(columns_ * rows_, kNone);
+  cell_count_.assign(columns_ * rows_, 0);
+  next_.resize(boids.size());
+  previous_.resize(boids.size());
+  boid_cell_.resize(boids.size());
+  /** Link in reverse, so every cell list ends up in index order */
+  for (int i = static_cast<int>(boids.size()) - 1; i >= 0; --i) {
+    link(i, cell_index_of(boids[i].position()));
+  }
+  reinsertions_ = boids.size();
+}
+
+void SpatialGrid::update(const Boids& boids, const Vector2s& origin, const Vector2u& size, Scalar cell_size) {
+  if (boids.size() != boid_cell_.size() || origin != origin_ || size != size_ || cell_size != cell_size_) {
+    rebuild(boids, origin, size, cell_size);
+    return;
+  }
+
+  reinsertions_ = 0;
+  for (std::size_t i = 0; i < boids.size(); ++i) {
+    const int kCell = cell_index_of(boids[i].position());
+    if (kCell != boid_cell_[i]) {
+      unlink(i);
+      link(i, kCell);
+      ++reinsertions_;
+    }
+  }
+}
+
+unsigned int SpatialGrid::reinsertions() const {
+  return reinsertions_;
+}
+
+Scalar SpatialGrid::cell_size() const {
+  return cell_size_;
+}
+
+Vector2s SpatialGrid::origin() const {
+  return origin_;
+}
+
+Vector2u SpatialGrid::size() const {
+  return size_;
+}
+
+void SpatialGrid::link(int boid, int cell) {
+  const int kHead = cell_head_[cell];
+  next_[boid] = kHead;
+  previous_[boid] = kNone;
+  if (kHead != kNone) {
+    previous_[kHead] = boid;
+  }
+  cell_head_[cell] = boid;
+  boid_cell_[boid] = cell;
+  ++cell_count_[cell];
+}
+
+void SpatialGrid::unlink(int boid) {
+  const int kCell = boid_cell_[boid];
+  if (previous_[boid] != kNone) {
+    next_[previous_[boid]] = next_[boid];
+  } else {
+    cell_head_[kCell] = next_[boid];
+  }
+  if (next_[boid] != kNone) {
+    previous_[next_[boid]] = previous_[boid];
+  }
+  --cell_count_[kCell];
+}
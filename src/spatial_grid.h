@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "scalar.h"
+#include "utils.h"
+
+class Boid;
+using Boids = std::vector<Boid>;
+
+/**
+ * Uniform grid over the world, every cell holds an intrusive doubly linked list of boid indices.
+ *
+ * Boids move less than a cell per tick most of the time, so the grid is updated incrementally: only boids which
+ * changed cells are unlinked and linked again.
+ */
+class SpatialGrid {
+ public:
+  /** Result of nearest neighbour query */
+  struct Neighbour {
+    Scalar distance_squared;
+    unsigned int index;
+  };
+
+  /**
+   * Rebuild grid from scratch.
+   *
+   * \param boids Boids, indices passed to the query callbacks refer to this container.
+   * \param origin Top left corner of the covered area, the world origin unless the world is open.
+   * \param size Size of the covered area, positions outside of it go to the border cells. Wrapping queries wrap
+   *             around it.
+   * \param cell_size Cell size, usually the largest query radius.
+   */
+  void rebuild(const Boids& boids, const Vector2s& origin, const Vector2u& size, Scalar cell_size);
+
+  /**
+   * Bring grid up to date with boids positions, moving only boids which changed cells.
+   *
+   * Falls back to a full rebuild if the number of boids, covered area or cell size changed.
+   *
+   * \param boids Boids, indices passed to the query callbacks refer to this container.
+   * \param origin Top left corner of the covered area.
+   * \param size Size of the covered area.
+   * \param cell_size Cell size, usually the largest query radius.
+   */
+  void update(const Boids& boids, const Vector2s& origin, const Vector2u& size, Scalar cell_size);
+
+  /** Number of boids (re)inserted by the last rebuild or update */
+  unsigned int reinsertions() const;
+
+  /**
+   * Call function with index of every boid stored in the cells overlapping given rect.
+   *
+   * \param min Top left corner of the rect in world coordinates.
+   * \param max Bottom right corner of the rect in world coordinates.
+   * \param function Function called with boid index.
+   */
+  template<class Function>
+  void for_each_in_rect(const Vector2s& min, const Vector2s& max, Function function) const {
+    for_each_in_rect_by_cell(min, max, [&](unsigned int index, const Vector2s&) { function(index); });
+  }
+
+  /**
+   * Same as for_each_in_rect, for data stored relative to the cell of the boid.
+   *
+   * \tparam kWrap Parts of the rect outside of the world continue on the opposite side of it, the rect has to be
+   *               smaller than the world. Cell corners passed to function stay inside the world, offsets measured
+   *               from them need toroidal_offset.
+   * \param min Top left corner of the rect in world coordinates.
+   * \param max Bottom right corner of the rect in world coordinates.
+   * \param function Function called with boid index and top left corner of its cell in world coordinates.
+   */
+  template<bool kWrap = false, class Function>
+  void for_each_in_rect_by_cell(const Vector2s& min, const Vector2s& max, Function function) const {
+    if (cell_head_.empty()) {
+      return;
+    }
+
+    /** Relative to the grid origin */
+    const Vector2s kMin = min - origin_;
+    const Vector2s kMax = max - origin_;
+    const CellSpan kColumns = kWrap ? wrapped_cell_span(kMin.x, kMax.x, size_.x, columns_)
+                                    : clamped_cell_span(kMin.x, kMax.x, columns_);
+    const CellSpan kRows = kWrap ? wrapped_cell_span(kMin.y, kMax.y, size_.y, rows_)
+                                 : clamped_cell_span(kMin.y, kMax.y, rows_);
+    for (int row_step = 0; row_step < kRows.count; ++row_step) {
+      /** Spans only run past the last cell when wrapping */
+      const int kRow = kRows.first + row_step - (kRows.first + row_step >= rows_ ? rows_ : 0);
+      for (int column_step = 0; column_step < kColumns.count; ++column_step) {
+        const int kColumn = kColumns.first + column_step - (kColumns.first + column_step >= columns_ ? columns_ : 0);
+        const Vector2s kCellOrigin = origin_ + Vector2s(kColumn * cell_size_, kRow * cell_size_);
+        for (int i = cell_head_[kRow * columns_ + kColumn]; i != kNone; i = next_[i]) {
+          function(static_cast<unsigned int>(i), kCellOrigin);
+        }
+      }
+    }
+  }
+
+  /**
+   * Call function with index of every boid that may be within given radius.
+   *
+   * Candidates are taken from the overlapping cells, so the caller still has to check the distance.
+   *
+   * \param position Query position.
+   * \param radius Query radius.
+   * \param function Function called with boid index.
+   */
+  template<class Function>
+  void for_each_in_radius(const Vector2s& position, Scalar radius, Function function) const {
+    for_each_in_rect(position - Vector2s(radius, radius), position + Vector2s(radius, radius), function);
+  }
+
+  /**
+   * Same as for_each_in_radius, for data stored relative to the cell of the boid.
+   *
+   * \tparam kWrap Search wraps around the world, radius has to be below half of the world size.
+   * \param position Query position.
+   * \param radius Query radius.
+   * \param function Function called with boid index and top left corner of its cell in world coordinates.
+   */
+  template<bool kWrap = false, class Function>
+  void for_each_in_radius_by_cell(const Vector2s& position, Scalar radius, Function function) const {
+    for_each_in_rect_by_cell<kWrap>(position - Vector2s(radius, radius),
+                                    position + Vector2s(radius, radius),
+                                    function);
+  }
+
+  /**
+   * Call function for every cell overlapping given rect.
+   *
+   * \param min Top left corner of the rect in world coordinates.
+   * \param max Bottom right corner of the rect in world coordinates.
+   * \param function Function called with top left corner of the cell in world coordinates, cell size and
+   *                 number of boids in the cell.
+   */
+  template<class Function>
+  void for_each_cell_in_rect(const Vector2s& min, const Vector2s& max, Function function) const {
+    if (cell_head_.empty()) {
+      return;
+    }
+
+    const Vector2i kFirstCell = cell_of(min);
+    const Vector2i kLastCell = cell_of(max);
+    for (int row = kFirstCell.y; row <= kLastCell.y; ++row) {
+      for (int column = kFirstCell.x; column <= kLastCell.x; ++column) {
+        function(origin_ + Vector2s(column * cell_size_, row * cell_size_),
+                 cell_size_,
+                 cell_count_[row * columns_ + column]);
+      }
+    }
+  }
+
+  /**
+   * Find up to k nearest boids within radius, excluding boids at exactly the query position.
+   *
+   * Cells are visited in rings around the query cell and the search stops once the k-th nearest boid found so far
+   * is closer than anything the next ring can contain, so the work is bounded in dense areas.
+   *
+   * \tparam kWrap Search wraps around the world and distances are measured with toroidal_offset, radius has to be
+   *               below half of the world size.
+   * \param position Query position.
+   * \param radius Query radius.
+   * \param k Maximum number of neighbours.
+   * \param position_of Function returning position of the boid with given index, also given the top left corner
+   *                    of the cell the boid is stored in.
+   * \param nearest Output array with room for k neighbours, left in heap order (not sorted).
+   * \return Number of neighbours found.
+   */
+  template<bool kWrap = false, class PositionOf>
+  unsigned int find_nearest(const Vector2s& position,
+                            Scalar radius,
+                            unsigned int k,
+                            PositionOf position_of,
+                            Neighbour* nearest) const {
+    if (cell_head_.empty() || k == 0) {
+      return 0;
+    }
+
+    const auto kFurther = [](const Neighbour& a, const Neighbour& b) {
+      return a.distance_squared < b.distance_squared;
+    };
+    unsigned int count = 0;
+    /** Squared distance a boid has to beat to get in, shrinks to the k-th nearest once the heap is full */
+    Scalar bound_squared = radius * radius;
+    const Vector2s kWorldSize(size_.x, size_.y);
+    /** Cell geometry is relative to the grid origin */
+    const Vector2s kLocal = position - origin_;
+    const Vector2i kCenter = cell_of(position);
+    /** Cells a ring may reach, wrapping they are centered on the query cell so no cell is visited twice */
+    const Vector2i kFirstCell = kWrap ? kCenter - Vector2i((columns_ - 1) / 2, (rows_ - 1) / 2) : Vector2i();
+    const Vector2i kLastCell = kFirstCell + Vector2i(columns_ - 1, rows_ - 1);
+
+    const auto kVisitCell = [&](int column, int row) {
+      if (column < kFirstCell.x || row < kFirstCell.y || column > kLastCell.x || row > kLastCell.y) {
+        return;
+      }
+
+      /** Cells beyond the world edges are the ones on the opposite side of it, moved by the world size */
+      Vector2s shift;
+      if (kWrap) {
+        shift.x = column < 0 ? -kWorldSize.x : (column >= columns_ ? kWorldSize.x : 0);
+        shift.y = row < 0 ? -kWorldSize.y : (row >= rows_ ? kWorldSize.y : 0);
+        column -= column < 0 ? -columns_ : (column >= columns_ ? columns_ : 0);
+        row -= row < 0 ? -rows_ : (row >= rows_ ? rows_ : 0);
+      }
+
+      /** Skip cells which can't contain anything closer than the current bound */
+      const Scalar kDx = std::max(std::max(column * cell_size_ + shift.x - kLocal.x,
+                                           kLocal.x - (column + 1) * cell_size_ - shift.x),
+                                  Scalar(0));
+      const Scalar kDy = std::max(std::max(row * cell_size_ + shift.y - kLocal.y,
+                                           kLocal.y - (row + 1) * cell_size_ - shift.y),
+                                  Scalar(0));
+      if (kDx * kDx + kDy * kDy >= bound_squared) {
+        return;
+      }
+
+      const Vector2s kCellOrigin = origin_ + Vector2s(column * cell_size_, row * cell_size_);
+      for (int i = cell_head_[row * columns_ + column]; i != kNone; i = next_[i]) {
+        const Vector2s kRawOffset = position_of(static_cast<unsigned int>(i), kCellOrigin) - position;
+        const Vector2s kOffset = kWrap ? toroidal_offset(kRawOffset, kWorldSize) : kRawOffset;
+        const Scalar kDistanceSquared = kOffset.x * kOffset.x + kOffset.y * kOffset.y;
+        if (kDistanceSquared == 0 || kDistanceSquared >= bound_squared) {
+          continue;
+        }
+
+        if (count == k) {
+          std::pop_heap(nearest, nearest + count, kFurther);
+          --count;
+        }
+        nearest[count++] = Neighbour{kDistanceSquared, static_cast<unsigned int>(i)};
+        std::push_heap(nearest, nearest + count, kFurther);
+        if (count == k) {
+          bound_squared = nearest[0].distance_squared;
+        }
+      }
+    };
+
+    /** Distance from position to the closest edge of its own cell, lower bound for the first ring */
+    const Scalar kEdgeDistance = std::max(Scalar(0), std::min(std::min(kLocal.x - kCenter.x * cell_size_,
+                                                                       (kCenter.x + 1) * cell_size_ - kLocal.x),
+                                                              std::min(kLocal.y - kCenter.y * cell_size_,
+                                                                       (kCenter.y + 1) * cell_size_ - kLocal.y)));
+    const int kMaxRing = std::max(columns_, rows_);
+    kVisitCell(kCenter.x, kCenter.y);
+    for (int ring = 1; ring <= kMaxRing; ++ring) {
+      /**
+       * The last cells of a world which isn't a whole number of cells are narrower, wrapping one of them may lie
+       * between position and the ring, so the bound drops by a whole cell instead of using the edge distance
+       */
+      const Scalar kRingDistance =
+        kWrap ? std::max(ring - 2, 0) * cell_size_ : (ring - 1) * cell_size_ + kEdgeDistance;
+      if (kRingDistance * kRingDistance >= bound_squared) {
+        break;
+      }
+
+      for (int column = kCenter.x - ring; column <= kCenter.x + ring; ++column) {
+        kVisitCell(column, kCenter.y - ring);
+        kVisitCell(column, kCenter.y + ring);
+      }
+      for (int row = kCenter.y - ring + 1; row <= kCenter.y + ring - 1; ++row) {
+        kVisitCell(kCenter.x - ring, row);
+        kVisitCell(kCenter.x + ring, row);
+      }
+    }
+
+    return count;
+  }
+
+  Scalar cell_size() const;
+  /** Covered area, see rebuild */
+  Vector2s origin() const;
+  Vector2u size() const;
+
+  /**
+   * Top left corner of the cell given position falls into, positions outside of the world go to the border cells.
+   *
+   * \param position Position in world coordinates.
+   * \return Corner in world coordinates.
+   */
+  Vector2s cell_origin(const Vector2s& position) const {
+    const Vector2i kCell = cell_of(position);
+    return origin_ + Vector2s(kCell.x * cell_size_, kCell.y * cell_size_);
+  }
+
+  /**
+   * Top left corner of the cell boid is stored in.
+   *
+   * \param index Boid index.
+   * \return Corner in world coordinates.
+   */
+  Vector2s cell_origin_of_boid(unsigned int index) const {
+    const int kCell = boid_cell_[index];
+    return origin_ + Vector2s((kCell % columns_) * cell_size_, (kCell / columns_) * cell_size_);
+  }
+ private:
+  Vector2i cell_of(const Vector2s& position) const {
+    const Vector2s kLocal = position - origin_;
+    return Vector2i(std::min(std::max(static_cast<int>(kLocal.x / cell_size_), 0), columns_ - 1),
+                    std::min(std::max(static_cast<int>(kLocal.y / cell_size_), 0), rows_ - 1));
+  }
+
+  int cell_index_of(const Vector2s& position) const {
+    const Vector2i kCell = cell_of(position);
+    return kCell.y * columns_ + kCell.x;
+  }
+
+  /** Cells covering a range along one axis, cells past the last one continue from the first */
+  struct CellSpan {
+    int first;
+    int count;
+  };
+
+  /** Cells covering <min, max> (relative to the grid origin) along one axis, clamped to the grid */
+  CellSpan clamped_cell_span(Scalar min, Scalar max, int cells) const {
+    const int kFirst = std::min(std::max(static_cast<int>(min / cell_size_), 0), cells - 1);
+    const int kLast = std::min(std::max(static_cast<int>(max / cell_size_), 0), cells - 1);
+    return CellSpan{kFirst, kLast - kFirst + 1};
+  }
+
+  /** Cells covering <min, max> (relative to the grid origin) along one axis, continued on the opposite side */
+  CellSpan wrapped_cell_span(Scalar min, Scalar max, Scalar world_size, int cells) const {
+    if (max - min >= world_size) {
+      return CellSpan{0, cells};
+    }
+
+    const int kFirst = std::min(static_cast<int>(wrap_coordinate(min, world_size) / cell_size_), cells - 1);
+    const int kLast = std::min(static_cast<int>(wrap_coordinate(max, world_size) / cell_size_), cells - 1);
+    const bool kWraps = min < 0 || max >= world_size;
+    return CellSpan{kFirst, std::min(kLast - kFirst + 1 + (kWraps ? cells : 0), cells)};
+  }
+
+  void link(int boid, int cell);
+  void unlink(int boid);
+
+  /** List terminator */
+  static constexpr int kNone = -1;
+
+  Scalar cell_size_ = 1;
+  int columns_ = 0;
+  int rows_ = 0;
+  Vector2s origin_;
+  Vector2u size_;
+  /** First boid in every cell */
+  std::vector<int> cell_head_;
+  std::vector<unsigned int> cell_count_;
+  /** Per boid links and cell */
+  std::vector<int> next_;
+  std::vector<int> previous_;
+  std::vector<int> boid_cell_;
+  unsigned int reinsertions_ = 0;
+};
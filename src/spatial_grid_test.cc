@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "boid.h"
+#include "spatial_grid.h"
+#include "utils.h"
+
+namespace {
+
+/** Neighbour counts checked, 64 is the topological mode maximum */
+constexpr std::array<unsigned int, 3> kNeighbourCounts = {1, 7, Boid::kMaxTopologicalNeighbours};
+
+int failures = 0;
+
+void fail(const std::string& scenario, const std::string& message) {
+  ++failures;
+  std::cerr << scenario << ": " << message << "\n";
+}
+
+/** Offset from position to boid, measured the way the grid measures it */
+template<bool kWrap>
+Vector2s offset_to(const Boid& boid, const Vector2s& position, const Vector2s& world_size) {
+  const Vector2s kOffset = boid.position() - position;
+  return kWrap ? toroidal_offset(kOffset, world_size) : kOffset;
+}
+
+Scalar squared(const Vector2s& offset) {
+  return offset.x * offset.x + offset.y * offset.y;
+}
+
+/**
+ * Compare find_nearest with a brute force search over all boids.
+ *
+ * Ties may be broken differently, so sorted distances are compared, plus every returned index has to be a distinct
+ * boid at the reported distance.
+ */
+template<bool kWrap>
+void check_nearest(const std::string& scenario,
+                   const Boids& boids,
+                   const Vector2u& world_size,
+                   Scalar cell_size,
+                   Scalar radius,
+                   const std::vector<Vector2s>& queries) {
+  SpatialGrid grid;
+  grid.rebuild(boids, Vector2s(), world_size, cell_size);
+  const Vector2s kWorldSize(world_size.x, world_size.y);
+  const auto kPositionOf = [&](unsigned int index, const Vector2s&) { return boids[index].position(); };
+
+  for (const unsigned int kK : kNeighbourCounts) {
+    const std::string kName = scenario + " k=" + std::to_string(kK);
+    for (const Vector2s& kQuery : queries) {
+      std::array<SpatialGrid::Neighbour, Boid::kMaxTopologicalNeighbours> nearest;
+      const unsigned int kCount = grid.find_nearest<kWrap>(kQuery, radius, kK, kPositionOf, nearest.data());
+
+      std::vector<Scalar> expected;
+      for (const Boid& kBoid : boids) {
+        const Scalar kDistanceSquared = squared(offset_to<kWrap>(kBoid, kQuery, kWorldSize));
+        if (kDistanceSquared != 0 && kDistanceSquared < radius * radius) {
+          expected.push_back(kDistanceSquared);
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+      expected.resize(std::min<std::size_t>(expected.size(), kK));
+
+      std::vector<Scalar> found;
+      std::vector<unsigned int> indices;
+      for (unsigned int i = 0; i < kCount; ++i) {
+        found.push_back(nearest[i].distance_squared);
+        indices.push_back(nearest[i].index);
+        if (squared(offset_to<kWrap>(boids[nearest[i].index], kQuery, kWorldSize)) != nearest[i].distance_squared) {
+          fail(kName, "wrong distance reported for boid " + std::to_string(nearest[i].index));
+        }
+      }
+      std::sort(found.begin(), found.end());
+      std::sort(indices.begin(), indices.end());
+      if (std::adjacent_find(indices.begin(), indices.end()) != indices.end()) {
+        fail(kName, "boid returned twice");
+      }
+      if (found != expected) {
+        fail(kName, "query (" + std::to_string(kQuery.x) + ", " + std::to_string(kQuery.y) + ") found " +
+                    std::to_string(found.size()) + " neighbours, expected " + std::to_string(expected.size()) +
+                    (found.size() == expected.size() ? ", not the nearest ones" : ""));
+        /** One report per scenario is enough */
+        return;
+      }
+    }
+  }
+}
+
+/**
+ * Compare for_each_in_radius_by_cell with a brute force search over all boids: every boid within radius has to be
+ * a candidate, no candidate may come twice and the cell corner passed along has to be the one of its cell.
+ */
+template<bool kWrap>
+void check_radius(const std::string& scenario,
+                  const Boids& boids,
+                  const Vector2u& world_size,
+                  Scalar cell_size,
+                  Scalar radius,
+                  const std::vector<Vector2s>& queries) {
+  SpatialGrid grid;
+  grid.rebuild(boids, Vector2s(), world_size, cell_size);
+  const Vector2s kWorldSize(world_size.x, world_size.y);
+
+  for (const Vector2s& kQuery : queries) {
+    std::vector<unsigned int> visits(boids.size(), 0);
+    bool wrong_cell = false;
+    grid.for_each_in_radius_by_cell<kWrap>(kQuery, radius, [&](unsigned int index, const Vector2s& cell_origin) {
+      ++visits[index];
+      wrong_cell = wrong_cell || cell_origin != grid.cell_origin_of_boid(index);
+    });
+
+    std::string error;
+    for (std::size_t i = 0; i < boids.size() && error.empty(); ++i) {
+      if (visits[i] > 1) {
+        error = "boid " + std::to_string(i) + " visited " + std::to_string(visits[i]) + " times";
+      } else if (visits[i] == 0 && squared(offset_to<kWrap>(boids[i], kQuery, kWorldSize)) < radius * radius) {
+        error = "boid " + std::to_string(i) + " within radius not visited";
+      }
+    }
+    if (error.empty() && wrong_cell) {
+      error = "wrong cell corner passed";
+    }
+    if (!error.empty()) {
+      fail(scenario, "query (" + std::to_string(kQuery.x) + ", " + std::to_string(kQuery.y) + "): " + error);
+      return;
+    }
+  }
+}
+
+Boids random_boids(unsigned int count, const Vector2s& size, std::mt19937& random) {
+  std::uniform_real_distribution<Scalar> x(0, size.x);
+  std::uniform_real_distribution<Scalar> y(0, size.y);
+  Boids boids;
+  for (unsigned int i = 0; i < count; ++i) {
+    boids.push_back(Boid(Vector2s(x(random), y(random)), 0));
+  }
+  return boids;
+}
+
+/** Positions of some boids (excluded themselves) and random points */
+std::vector<Vector2s> queries_for(const Boids& boids, const Vector2s& size, std::mt19937& random) {
+  std::vector<Vector2s> queries;
+  for (std::size_t i = 0; i < boids.size(); i += std::max<std::size_t>(1, boids.size() / 200)) {
+    queries.push_back(boids[i].position());
+  }
+  const Boids kPoints = random_boids(200, size, random);
+  for (const Boid& kPoint : kPoints) {
+    queries.push_back(kPoint.position());
+  }
+  return queries;
+}
+
+void test_nearest() {
+  std::mt19937 random(1);
+
+  {
+    const Vector2u kWorld(1000, 800);
+    const Vector2s kSize(kWorld.x, kWorld.y);
+    const Boids kBoids = random_boids(2000, kSize, random);
+    check_nearest<false>("uniform", kBoids, kWorld, 50, 100, queries_for(kBoids, kSize, random));
+  }
+
+  {
+    /** Lattice, every query has many neighbours at exactly the same distance, some boids are stacked */
+    const Vector2u kWorld(200, 200);
+    Boids boids;
+    for (int row = 0; row < 20; ++row) {
+      for (int column = 0; column < 20; ++column) {
+        boids.push_back(Boid(Vector2s(5 + column * 10, 5 + row * 10), 0));
+        if ((row * 20 + column) % 7 == 0) {
+          boids.push_back(boids.back());
+        }
+      }
+    }
+    std::vector<Vector2s> queries;
+    for (int i = 0; i < 200; i += 5) {
+      queries.push_back(Vector2s(5 + i % 20 * 10, 5 + i / 20 * 10));
+      queries.push_back(Vector2s(10 + i % 20 * 10, 10 + i / 20 * 10));
+    }
+    check_nearest<false>("lattice ties", boids, kWorld, 25, 60, queries);
+  }
+
+  {
+    /** Mostly empty cells, fewer than k boids within the radius */
+    const Vector2u kWorld(2000, 2000);
+    const Vector2s kSize(kWorld.x, kWorld.y);
+    const Boids kBoids = random_boids(40, kSize, random);
+    check_nearest<false>("sparse", kBoids, kWorld, 100, 500, queries_for(kBoids, kSize, random));
+  }
+}
+
+/** Boids within band of the world edges, so most neighbourhoods continue on the opposite side */
+Boids seam_boids(unsigned int count, const Vector2s& size, Scalar band, std::mt19937& random) {
+  std::uniform_real_distribution<Scalar> along(0, 1);
+  std::uniform_real_distribution<Scalar> across(0, band);
+  Boids boids;
+  for (unsigned int i = 0; i < count; ++i) {
+    /** Left, right, top or bottom edge */
+    const unsigned int kEdge = i % 4;
+    const Scalar kAcross = kEdge % 2 == 0 ? across(random) : -across(random);
+    const Vector2s kPosition = kEdge < 2
+      ? Vector2s(kEdge == 0 ? kAcross : size.x + kAcross, along(random) * size.y)
+      : Vector2s(along(random) * size.x, kEdge == 2 ? kAcross : size.y + kAcross);
+    boids.push_back(Boid(wrap_position(kPosition, size), 0));
+  }
+  return boids;
+}
+
+void test_wrap() {
+  std::mt19937 random(2);
+
+  /** Worlds which are not a whole number of cells, the last cells are narrower */
+  struct World {
+    const char* name;
+    Vector2u size;
+    Scalar cell_size;
+    Scalar radius;
+  };
+  const World kWorlds[] = {
+    {"wrap", Vector2u(1000, 800), 60, 100},
+    {"wrap partial cells", Vector2u(530, 370), 50, 90},
+    /** Radius close to half of the world, rings reach around it */
+    {"wrap small world", Vector2u(300, 250), 70, 120},
+  };
+  for (const World& kWorld : kWorlds) {
+    const Vector2s kSize(kWorld.size.x, kWorld.size.y);
+    Boids boids = random_boids(600, kSize, random);
+    const Boids kSeam = seam_boids(600, kSize, 40, random);
+    boids.insert(boids.end(), kSeam.begin(), kSeam.end());
+
+    std::vector<Vector2s> queries = queries_for(boids, kSize, random);
+    const std::vector<Vector2s> kCorners = {
+      Vector2s(0, 0), Vector2s(kSize.x - Scalar(0.5), kSize.y - Scalar(0.5)), Vector2s(0, kSize.y / 2),
+      Vector2s(kSize.x / 2, kSize.y - Scalar(0.5)), Vector2s(kSize.x - 1, 1),
+    };
+    queries.insert(queries.end(), kCorners.begin(), kCorners.end());
+
+    check_radius<true>(std::string(kWorld.name) + " radius", boids, kWorld.size, kWorld.cell_size, kWorld.radius,
+                       queries);
+    check_nearest<true>(std::string(kWorld.name) + " nearest", boids, kWorld.size, kWorld.cell_size, kWorld.radius,
+                        queries);
+  }
+}
+
+}  // namespace
+
+/** Brute force checks of the spatial grid queries, the first mismatch of every scenario is reported */
+int main() {
+  test_nearest();
+  test_wrap();
+  if (failures > 0) {
+    std::cerr << failures << " failures\n";
+    return 1;
+  }
+  std::cout << "passed\n";
+  return 0;
+}
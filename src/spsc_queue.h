@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free bounded single producer / single consumer queue.
+ */
+template<class T, std::size_t kCapacity>
+class SpscQueue {
+ public:
+  /**
+   * Push value, never blocks.
+   *
+   * \param value Value.
+   * \return True if value was queued, false if the queue is full.
+   */
+  bool push(const T& value) {
+    const std::size_t kTail = tail_.load(std::memory_order_relaxed);
+    const std::size_t kNextTail = (kTail + 1) % kSize;
+    if (kNextTail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    items_[kTail] = value;
+    tail_.store(kNextTail, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Pop value, never blocks.
+   *
+   * \param value Popped value.
+   * \return True if value was popped, false if the queue is empty.
+   */
+  bool pop(T& value) {
+    const std::size_t kHead = head_.load(std::memory_order_relaxed);
+    if (kHead == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    value = items_[kHead];
+    head_.store((kHead + 1) % kSize, std::memory_order_release);
+    return true;
+  }
+ private:
+  /** One slot is always kept free to tell full and empty apart */
+  static constexpr std::size_t kSize = kCapacity + 1;
+
+  std::array<T, kSize> items_;
+  std::atomic<std::size_t> head_{0};
+  std::atomic<std::size_t> tail_{0};
+};
@@ -0,0 +1,104 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+/** Get chunk [begin, end) processed by given thread */
+void chunk_range(std::size_t count, unsigned int chunks, unsigned int chunk, std::size_t& begin, std::size_t& end) {
+  const std::size_t kChunkSize = count / chunks;
+  const std::size_t kRemainder = count % chunks;
+  begin = chunk * kChunkSize + std::min<std::size_t>(chunk, kRemainder);
+  end = begin + kChunkSize + (chunk < kRemainder ? 1 : 0);
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(unsigned int thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  /** Calling thread also processes a chunk */
+  for (unsigned int i = 1; i < thread_count; ++i) {
+    workers_.emplace_back([this, i] { worker_loop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_available_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(std::size_t count, const RangeFunction& function) {
+  if (workers_.empty() || count < thread_count()) {
+    function(0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    function_ = &function;
+    count_ = count;
+    allocation_phase_ = AllocationScope::current_phase();
+    allocations_forbidden_ = AllocationScope::allocations_forbidden();
+    pending_workers_ = workers_.size();
+    ++generation_;
+  }
+  work_available_.notify_all();
+
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  chunk_range(count, thread_count(), 0, begin, end);
+  function(begin, end);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_done_.wait(lock, [&] { return pending_workers_ == 0; });
+  function_ = nullptr;
+}
+
+unsigned int ThreadPool::thread_count() const {
+  return workers_.size() + 1;
+}
+
+void ThreadPool::worker_loop(unsigned int worker_index) {
+  unsigned int seen_generation = 0;
+  while (true) {
+    const RangeFunction* function = nullptr;
+    std::size_t count = 0;
+    AllocationPhase allocation_phase = AllocationPhase::kOther;
+    bool allocations_forbidden = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+      if (stop_) {
+        return;
+      }
+      seen_generation = generation_;
+      function = function_;
+      count = count_;
+      allocation_phase = allocation_phase_;
+      allocations_forbidden = allocations_forbidden_;
+    }
+
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    chunk_range(count, thread_count(), worker_index, begin, end);
+    {
+      AllocationScope allocation_scope(allocation_phase, allocations_forbidden);
+      (*function)(begin, end);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --pending_workers_;
+    }
+    work_done_.notify_one();
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "allocation_tracker.h"
+
+/**
+ * Minimal fixed size thread pool used to split per-frame work into chunks.
+ */
+class ThreadPool {
+ public:
+  /** Range function, called with [begin, end) of the chunk to process. */
+  using RangeFunction = std::function<void(std::size_t begin, std::size_t end)>;
+
+  /**
+   * Create thread pool.
+   *
+   * \param thread_count Number of threads (including the calling one), 0 means hardware concurrency.
+   */
+  explicit ThreadPool(unsigned int thread_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Split [0, count) into chunks and process them in parallel, blocks until all chunks are done.
+   *
+   * Chunks run in the allocation phase of the calling thread.
+   *
+   * \param count Number of items.
+   * \param function Function called for every chunk.
+   */
+  template<class Function>
+  void parallel_for(std::size_t count, const Function& function) {
+    /** Reference wrapper fits the small buffer of std::function, a capturing lambda would go to the heap */
+    run(count, RangeFunction(std::cref(function)));
+  }
+
+  unsigned int thread_count() const;
+ private:
+  void run(std::size_t count, const RangeFunction& function);
+  void worker_loop(unsigned int worker_index);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable work_done_;
+  const RangeFunction* function_ = nullptr;
+  std::size_t count_ = 0;
+  AllocationPhase allocation_phase_ = AllocationPhase::kOther;
+  bool allocations_forbidden_ = false;
+  unsigned int generation_ = 0;
+  unsigned int pending_workers_ = 0;
+  bool stop_ = false;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+/**
+ * Lock-free single producer / single consumer triple buffer.
+ *
+ * The writer fills write_buffer() and publishes it, the reader picks up the latest published buffer with
+ * update(). Neither side ever waits for the other one, intermediate buffers are dropped if the reader is slower.
+ */
+template<class T>
+class TripleBuffer {
+ public:
+  /** Buffer owned by the writer */
+  T& write_buffer() {
+    return buffers_[back_];
+  }
+
+  /** Publish write buffer, writer gets another free buffer */
+  void publish() {
+    back_ = middle_.exchange(back_ | kDirtyBit, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /**
+   * Take the latest published buffer if there is a new one.
+   *
+   * \return True if read buffer changed, false otherwise.
+   */
+  bool update() {
+    if (!(middle_.load(std::memory_order_relaxed) & kDirtyBit)) {
+      return false;
+    }
+
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  /** Buffer owned by the reader */
+  const T& read_buffer() const {
+    return buffers_[front_];
+  }
+ private:
+  static constexpr unsigned int kIndexMask = 0x3;
+  /** Set in middle_ when it holds a buffer the reader hasn't seen yet */
+  static constexpr unsigned int kDirtyBit = 0x4;
+
+  std::array<T, 3> buffers_;
+  unsigned int front_ = 0;
+  std::atomic<unsigned int> middle_{1};
+  unsigned int back_ = 2;
+};
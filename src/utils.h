@@ -1,17 +1,30 @@
 #pragma once
 
-#include <SFML/System.hpp>
 #include <cmath>
+#include <cstdint>
+#include "vector2.h"
 
 template<class T>
 constexpr T kPi = T(3.1415926535897932385);
 
 template<class T>
-T distance_2d(const sf::Vector2<T>& a, const sf::Vector2<T>& b) {
-  sf::Vector2<T> diff = a - b;
+T distance_2d(const Vector2<T>& a, const Vector2<T>& b) {
+  Vector2<T> diff = a - b;
   return std::sqrt(diff.x * diff.x + diff.y * diff.y);
 }
 
+template<class T>
+T length(const Vector2<T>& a) {
+  return std::sqrt(a.x * a.x + a.y * a.y);
+}
+
+/** Unit vector with the direction of a, zero vector stays zero */
+template<class T>
+Vector2<T> normalized(const Vector2<T>& a) {
+  const T kLength = length(a);
+  return kLength > 0 ? a / kLength : a;
+}
+
 template<class T>
 T rad2deg(T rad) {
   return (rad * 180) / kPi<T>;
@@ -30,3 +43,61 @@ T constraint_angle_0_360(T angle) {
   }
   return angle;
 }
+
+/**
+ * Coordinate wrapped into <0, size) without branches, comparisons become masks instead of jumps.
+ *
+ * Only valid up to one size outside of the range, enough for anything moving less than the world per tick.
+ */
+template<class T>
+T wrap_coordinate(T value, T size) {
+  return value + size * static_cast<T>((value < 0) - (value >= size));
+}
+
+/** Position wrapped into the world, see wrap_coordinate */
+template<class T>
+Vector2<T> wrap_position(const Vector2<T>& position, const Vector2<T>& world_size) {
+  return Vector2<T>(wrap_coordinate(position.x, world_size.x), wrap_coordinate(position.y, world_size.y));
+}
+
+/**
+ * Shortest of the offsets between two points of a world which wraps around (minimum image), without branches.
+ *
+ * \param offset Offset between two points inside the world, so below world size on both axes.
+ * \param world_size World size.
+ * \return Offset with the same images of both points, at most half the world size on both axes.
+ */
+template<class T>
+Vector2<T> toroidal_offset(const Vector2<T>& offset, const Vector2<T>& world_size) {
+  const Vector2<T> kHalf = world_size / T(2);
+  return Vector2<T>(offset.x - world_size.x * static_cast<T>((offset.x > kHalf.x) - (offset.x < -kHalf.x)),
+                    offset.y - world_size.y * static_cast<T>((offset.y > kHalf.y) - (offset.y < -kHalf.y)));
+}
+
+/** Spread lower 16 bits of value to the even bits of the result */
+inline std::uint32_t spread_bits_16(std::uint32_t value) {
+  value &= 0x0000ffff;
+  value = (value | (value << 8)) & 0x00ff00ff;
+  value = (value | (value << 4)) & 0x0f0f0f0f;
+  value = (value | (value << 2)) & 0x33333333;
+  value = (value | (value << 1)) & 0x55555555;
+  return value;
+}
+
+/** Morton (Z-order) code of 16 bit coordinates, points close in 2D are mostly close in code order */
+inline std::uint32_t morton_code_2d(std::uint32_t x, std::uint32_t y) {
+  return spread_bits_16(x) | (spread_bits_16(y) << 1);
+}
+
+/** Unit direction of given rotation in degrees, rotation 0 faces "up" (negative y) */
+template<class T>
+Vector2<T> rotation_to_direction(T rotation) {
+  const T kRad = deg2rad(rotation);
+  return Vector2<T>(std::sin(kRad), -std::cos(kRad));
+}
+
+/** Rotation in degrees <0, 360) facing given direction, inverse of rotation_to_direction */
+template<class T>
+T direction_to_rotation(const Vector2<T>& direction) {
+  return constraint_angle_0_360(rad2deg(std::atan2(direction.y, direction.x)) + 90);
+}
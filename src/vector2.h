@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * Minimal 2D vector, keeps the simulation core independent of the graphics library.
+ */
+template<class T>
+struct Vector2 {
+  Vector2() = default;
+  Vector2(T x, T y) : x(x), y(y) {}
+
+  template<class U>
+  explicit Vector2(const Vector2<U>& other) : x(static_cast<T>(other.x)), y(static_cast<T>(other.y)) {}
+
+  T x = 0;
+  T y = 0;
+};
+
+using Vector2f = Vector2<float>;
+using Vector2i = Vector2<int>;
+using Vector2u = Vector2<unsigned int>;
+
+template<class T>
+Vector2<T> operator-(const Vector2<T>& a) {
+  return Vector2<T>(-a.x, -a.y);
+}
+
+template<class T>
+Vector2<T> operator+(const Vector2<T>& a, const Vector2<T>& b) {
+  return Vector2<T>(a.x + b.x, a.y + b.y);
+}
+
+template<class T>
+Vector2<T> operator-(const Vector2<T>& a, const Vector2<T>& b) {
+  return Vector2<T>(a.x - b.x, a.y - b.y);
+}
+
+template<class T>
+Vector2<T> operator*(const Vector2<T>& a, T b) {
+  return Vector2<T>(a.x * b, a.y * b);
+}
+
+template<class T>
+Vector2<T> operator*(T a, const Vector2<T>& b) {
+  return Vector2<T>(a * b.x, a * b.y);
+}
+
+template<class T>
+Vector2<T> operator/(const Vector2<T>& a, T b) {
+  return Vector2<T>(a.x / b, a.y / b);
+}
+
+template<class T>
+Vector2<T>& operator+=(Vector2<T>& a, const Vector2<T>& b) {
+  a.x += b.x;
+  a.y += b.y;
+  return a;
+}
+
+template<class T>
+Vector2<T>& operator-=(Vector2<T>& a, const Vector2<T>& b) {
+  a.x -= b.x;
+  a.y -= b.y;
+  return a;
+}
+
+template<class T>
+Vector2<T>& operator*=(Vector2<T>& a, T b) {
+  a.x *= b;
+  a.y *= b;
+  return a;
+}
+
+template<class T>
+Vector2<T>& operator/=(Vector2<T>& a, T b) {
+  a.x /= b;
+  a.y /= b;
+  return a;
+}
+
+template<class T>
+bool operator==(const Vector2<T>& a, const Vector2<T>& b) {
+  return a.x == b.x && a.y == b.y;
+}
+
+template<class T>
+bool operator!=(const Vector2<T>& a, const Vector2<T>& b) {
+  return !(a == b);
+}